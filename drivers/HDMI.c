@@ -28,6 +28,7 @@ enum graphics_mode_t hdmi_graphics_mode = 1;  // Use default/simple case
 static uint8_t *graphics_buffer = NULL;
 static volatile uint8_t *graphics_pending_buffer = NULL;
 static volatile uint32_t graphics_frame_count = 0;
+static graphics_line_cb_t graphics_line_cb = NULL;
 
 void graphics_set_buffer(uint8_t *buffer) {
     graphics_buffer = buffer;
@@ -37,6 +38,10 @@ void graphics_request_buffer_swap(uint8_t *buffer) {
     graphics_pending_buffer = buffer;
 }
 
+void graphics_set_line_callback(graphics_line_cb_t cb) {
+    graphics_line_cb = cb;
+}
+
 uint32_t hdmi_get_frame_count(void) {
     return graphics_frame_count;
 }
@@ -64,8 +69,12 @@ void graphics_set_shift(int x, int y) {
 }
 
 uint8_t* __not_in_flash_func(get_line_buffer)(int line) {
-    if (!graphics_buffer) return NULL;
     if (line < 0 || line >= graphics_buffer_height) return NULL;
+    if (graphics_line_cb) {
+        uint8_t *l = graphics_line_cb(line);
+        if (l) return l;
+    }
+    if (!graphics_buffer) return NULL;
     return graphics_buffer + line * graphics_buffer_width;
 }
 
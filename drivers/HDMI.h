@@ -56,6 +56,10 @@ void graphics_set_buffer(uint8_t *buffer);
 uint8_t* graphics_get_buffer(void);
 // Request a buffer swap at the next vsync (frame boundary).
 void graphics_request_buffer_swap(uint8_t *buffer);
+// Source of screen lines, called from the DMA IRQ for each line 'y' before it
+// is sent out. Returns the line, or NULL to send the frame buffer line.
+typedef uint8_t *(*graphics_line_cb_t)(int y);
+void graphics_set_line_callback(graphics_line_cb_t cb);
 // Returns a monotonically increasing frame counter (incremented on vsync).
 uint32_t hdmi_get_frame_count(void);
 // Returns the HDMI DMA IRQ count (for detecting stalls).
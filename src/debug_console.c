@@ -0,0 +1,148 @@
+/*
+ * debug_console.c
+ *
+ * Breakpoint and watchpoint commands on the UART console, using
+ * mii_debug_bp_set(). Watched pages leave the CPU fast path, the others
+ * keep running at full speed; 'b' breakpoints make the CPU run one
+ * instruction at a time.
+ *
+ *   b <addr>            break when the instruction at <addr> runs
+ *   w <addr> [<len>]    break on writes
+ *   r <addr> [<len>]    break on reads
+ *   rw <addr> [<len>]   break on reads and writes
+ *   d <n>               delete breakpoint <n>
+ *   l                   list breakpoints
+ *   m <addr> [<len>]    dump memory, as the CPU sees it
+ *   c                   continue
+ *
+ * Addresses and lengths are in hex.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "debug_console.h"
+#include "mii.h"
+
+static char line[32];
+static int line_len = 0;
+static bool stop_reported = false;
+
+static void
+console_help(void)
+{
+    printf("b <addr> | w|r|rw <addr> [<len>] | d <n> | l | m <addr> [<len>] | c\n");
+}
+
+static void
+console_list(mii_t *mii)
+{
+    for (int i = 0; i < (int)sizeof(mii->debug.bp_map) * 8; i++) {
+        if (!(mii->debug.bp_map & (1 << i)))
+            continue;
+        uint8_t kind = mii->debug.bp[i].kind;
+        printf("%2d: %s%s%s $%04X-$%04X\n", i,
+            kind & MII_BP_PC ? "b" : "",
+            kind & MII_BP_R ? "r" : "",
+            kind & MII_BP_W ? "w" : "",
+            mii->debug.bp[i].addr,
+            mii->debug.bp[i].addr + mii->debug.bp[i].size - 1);
+    }
+}
+
+static void
+console_dump(mii_t *mii, uint16_t addr, uint16_t len)
+{
+    uint8_t buf[256];
+    mii_read_range(mii, addr, buf, len);
+    for (int i = 0; i < len; i += 16) {
+        printf("%04X:", (uint16_t)(addr + i));
+        for (int j = i; j < i + 16 && j < len; j++)
+            printf(" %02X", buf[j]);
+        printf("\n");
+    }
+}
+
+static void
+console_report(mii_t *mii)
+{
+    mii_cpu_t *cpu = &mii->cpu;
+    mii_cpu_state_t hit = mii->debug.hit;
+
+    for (int i = 0; i < (int)sizeof(mii->debug.bp_map) * 8; i++) {
+        if (!(mii->debug.bp[i].kind & MII_BP_HIT))
+            continue;
+        mii->debug.bp[i].kind &= ~MII_BP_HIT;
+        printf("Breakpoint %d: %s $%04X = $%02X\n", i,
+            hit.sync ? "PC" : hit.w ? "write" : "read", hit.addr, hit.data);
+    }
+    uint8_t p = 0;
+    MII_GET_P(cpu, p);
+    printf("Stopped at PC:%04X A:%02X X:%02X Y:%02X S:%02X P:%02X\n",
+        cpu->PC, cpu->A, cpu->X, cpu->Y, cpu->S, p);
+}
+
+static void
+console_command(mii_t *mii, char *cmd)
+{
+    char *arg = cmd;
+    while (*arg && *arg != ' ')
+        arg++;
+    int len = arg - cmd;
+    uint32_t addr = strtoul(arg, &arg, 16);
+    uint32_t size = strtoul(arg, NULL, 16);
+
+    uint8_t kind = 0;
+    if (len == 1 && cmd[0] == 'b') {
+        kind = MII_BP_PC;
+        size = 1;
+    } else if (len == 1 && cmd[0] == 'w')
+        kind = MII_BP_W;
+    else if (len == 1 && cmd[0] == 'r')
+        kind = MII_BP_R;
+    else if (len == 2 && !strncmp(cmd, "rw", 2))
+        kind = MII_BP_R | MII_BP_W;
+
+    if (kind) {
+        if (!size)
+            size = 1;
+        if (size > 255)
+            size = 255;
+        int i = mii_debug_bp_set(mii, kind, addr, size);
+        if (i < 0)
+            printf("No breakpoints left\n");
+        else
+            printf("Breakpoint %d set\n", i);
+    } else if (len == 1 && cmd[0] == 'd') {
+        mii_debug_bp_clear(mii, addr);
+    } else if (len == 1 && cmd[0] == 'l') {
+        console_list(mii);
+    } else if (len == 1 && cmd[0] == 'm') {
+        console_dump(mii, addr, size ? (size > 256 ? 256 : size) : 64);
+    } else if (len == 1 && cmd[0] == 'c') {
+        if (mii->state == MII_STOPPED) {
+            stop_reported = false;
+            mii->state = MII_RUNNING;
+        }
+    } else if (len)
+        console_help();
+}
+
+void
+debug_console_poll(mii_t *mii)
+{
+    if (mii->state == MII_STOPPED && !stop_reported) {
+        stop_reported = true;
+        console_report(mii);
+    }
+    int c;
+    while ((c = getchar_timeout_us(0)) != PICO_ERROR_TIMEOUT) {
+        if (c == '\r' || c == '\n') {
+            line[line_len] = 0;
+            line_len = 0;
+            console_command(mii, line);
+        } else if (line_len < (int)sizeof(line) - 1)
+            line[line_len++] = c;
+    }
+}
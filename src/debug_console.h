@@ -0,0 +1,17 @@
+/*
+ * debug_console.h
+ *
+ * Breakpoint and watchpoint commands on the UART console
+ */
+
+#ifndef DEBUG_CONSOLE_H
+#define DEBUG_CONSOLE_H
+
+// Forward declaration
+struct mii_t;
+
+// Read and run console commands, and report breakpoint hits.
+// Called once per frame from the main loop, doesn't block.
+void debug_console_poll(struct mii_t *mii);
+
+#endif // DEBUG_CONSOLE_H
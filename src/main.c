@@ -11,6 +11,7 @@
 #include "hardware/vreg.h"
 #include "hardware/clocks.h"
 #include "hardware/structs/qmi.h"
+#include "hardware/structs/xip_ctrl.h"
 #include "hardware/dma.h"  // Include DMA header early before mii_sw.h
 
 #include "board_config.h"
@@ -30,6 +31,7 @@
 #include "disk_loader.h"
 #include "mii_startscreen.h"
 #include "disk_ui.h"
+#include "debug_console.h"
 #include "debug_log.h"
 
 #ifdef MII_RP2350
@@ -38,6 +40,7 @@
 
 // Special key codes from keyboard driver
 #define KEY_F11 0xFB
+#define KEY_F12 0xFC
 
 // Stubs for desktop-only functions we don't use on RP2350
 // Note: mii_analog_access is now provided by mii_analog.c for paddle timing
@@ -182,6 +185,13 @@ static void process_keyboard(void) {
                 disk_ui_toggle();
                 continue;
             }
+            // F12 - native Monitor ROM routines on/off
+            if (key == KEY_F12) {
+                mii_rom_hook_enable(&g_mii, !g_mii.rom_hook.enabled);
+                MII_DEBUG_PRINTF("ROM hooks %s\n",
+                        g_mii.rom_hook.enabled ? "on" : "off");
+                continue;
+            }
             
             // If disk UI is visible, send keys to it
             if (disk_ui_is_visible()) {
@@ -214,6 +224,13 @@ static void process_keyboard(void) {
                 disk_ui_toggle();
                 continue;
             }
+            // F12 - native Monitor ROM routines on/off
+            if (key == KEY_F12) {
+                mii_rom_hook_enable(&g_mii, !g_mii.rom_hook.enabled);
+                MII_DEBUG_PRINTF("ROM hooks %s\n",
+                        g_mii.rom_hook.enabled ? "on" : "off");
+                continue;
+            }
             
             // If disk UI is visible, send keys to it
             if (disk_ui_is_visible()) {
@@ -276,6 +293,108 @@ void clear_held_key(void) {
 // Flag to indicate emulator is ready
 static volatile bool g_emulator_ready = false;
 
+// Time core 1 spent rendering the emulated screen, for the PERF output
+static volatile uint32_t g_video_render_us = 0;
+
+#if MII_VIDEO_SCANLINE
+// Racing the beam: core 1 draws each line into a small ring, a few lines
+// ahead of the HDMI DMA IRQ, which sends it out instead of the frame buffer
+// line. Lines are numbered from the first frame, frame * HDMI_HEIGHT + y;
+// that wraps at 2^32, so the ring slot is worked out from frame % ring size.
+static uint8_t g_scan_line[MII_VIDEO_SCANLINE][HDMI_WIDTH] __attribute__((aligned(4)));
+static volatile uint32_t g_scan_tag[MII_VIDEO_SCANLINE];  // line each slot holds
+static volatile uint32_t g_scan_beam = 0;       // line the IRQ last sent out
+static volatile uint32_t g_scan_start = 0;      // first frame to race
+static volatile bool g_scan_request = false;    // core 1 is racing
+static volatile bool g_scan_racing = false;     // this frame is raced, set on line 0
+// Stats for the PERF output
+static volatile uint32_t g_scan_underruns = 0;  // lines not ready in time
+static volatile uint32_t g_scan_frames = 0;
+static volatile uint32_t g_scan_worst_us = 0;
+static volatile uint32_t g_scan_fallbacks = 0;
+static uint32_t g_scan_budget_us = 0;           // time a line is on screen
+
+static inline int scanline_slot(uint32_t frame, int y) {
+    return ((frame % MII_VIDEO_SCANLINE) * HDMI_HEIGHT + y) % MII_VIDEO_SCANLINE;
+}
+
+// HDMI DMA IRQ: the line core 1 drew for 'y', or NULL for the frame buffer
+static uint8_t *__not_in_flash_func(scanline_get)(int y) {
+    uint32_t frame = hdmi_get_frame_count();
+    uint32_t pos = frame * HDMI_HEIGHT + y;
+    if (y == 0)
+        g_scan_racing = g_scan_request && (int32_t)(frame - g_scan_start) >= 0;
+    g_scan_beam = pos;
+    if (!g_scan_racing || !g_scan_request)
+        return NULL;
+    int slot = scanline_slot(frame, y);
+    if (g_scan_tag[slot] != pos) {
+        g_scan_underruns++;
+        return NULL;
+    }
+    return g_scan_line[slot];
+}
+
+// Core 1: draw 'frame' a line at a time, ahead of the beam. Returns false if
+// a line was late or took longer than it is on screen, or the UI opened.
+static bool scanline_frame(uint32_t frame) {
+    uint32_t start = frame * HDMI_HEIGHT;
+    uint32_t underruns = g_scan_underruns;
+    uint32_t worst = 0;
+
+    for (int y = 0; y < HDMI_HEIGHT; y++) {
+        uint32_t pos = start + y;
+        int slot = scanline_slot(frame, y);
+        // the slot is free once the IRQ moved past the line it holds
+        uint32_t wait = time_us_32();
+        while ((int32_t)(pos - g_scan_beam) >= MII_VIDEO_SCANLINE) {
+            if (disk_ui_is_visible() || time_us_32() - wait > 100000)
+                return false;
+            tight_loop_contents();
+        }
+        if ((int32_t)(pos - g_scan_beam) <= 0)
+            continue;   // too late, the IRQ counted it
+        uint32_t t = time_us_32();
+        mii_video_scanline(&g_mii.video, y, g_scan_line[slot]);
+        t = time_us_32() - t;
+        if (t > worst)
+            worst = t;
+        __atomic_thread_fence(__ATOMIC_RELEASE);    // pixels before the tag
+        g_scan_tag[slot] = pos;
+    }
+    g_scan_frames++;
+    if (worst > g_scan_worst_us)
+        g_scan_worst_us = worst;
+    return worst <= g_scan_budget_us && g_scan_underruns == underruns;
+}
+
+// Core 1: redraw the frame buffer, which is also the one on screen, a row at
+// a time once the IRQ has sent that row out, and before it comes back to it.
+static void scanline_behind(void) {
+    uint32_t pos = hdmi_get_frame_count() * HDMI_HEIGHT;
+    uint32_t wait = time_us_32();
+    uint32_t drawn = 0;
+
+    for (int y = 0; y < HDMI_HEIGHT; y++, pos++) {
+        int32_t behind;
+        while ((behind = (int32_t)(g_scan_beam - pos)) <= 0 ||
+                behind >= HDMI_HEIGHT - 1) {
+            if (behind > 0)
+                pos += HDMI_HEIGHT;     // lapped, wait for the next frame
+            else if (time_us_32() - wait > 100000)
+                return;
+            tight_loop_contents();
+        }
+        uint32_t t = time_us_32();
+        mii_video_scanline(&g_mii.video, y, g_hdmi_back_buffer + y * HDMI_WIDTH);
+        drawn += time_us_32() - t;
+        wait = time_us_32();
+    }
+    g_video_render_us += drawn;
+    g_mii.video.renders++;
+}
+#endif
+
 // Core 1 - Video rendering loop
 static void core1_main(void) {
     MII_DEBUG_PRINTF("Core 1: Waiting for emulator ready...\n");
@@ -289,9 +408,44 @@ static void core1_main(void) {
     
     bool was_ui_visible = false;
     uint32_t last_frame = hdmi_get_frame_count();
+#if MII_VIDEO_SCANLINE
+    // 2 HDMI lines per screen line
+    struct video_mode_t mode = graphics_get_video_mode(0);
+    g_scan_budget_us = 2000000 / (mode.freq * mode.h_total);
+    uint32_t race_frame = 0;
+    int backoff = 0;    // frames on the frame buffer before racing again
+    graphics_set_line_callback(scanline_get);
+#endif
     
     while (1) {
+#if MII_VIDEO_SCANLINE
+        if (!disk_ui_is_visible() && !backoff) {
+            if (!g_scan_request) {
+                // The frame buffer stays on screen until the racing starts
+                scanline_behind();
+                race_frame = hdmi_get_frame_count() + 2;
+                g_scan_start = race_frame;
+                g_scan_request = true;
+            }
+            was_ui_visible = false;
+            if (scanline_frame(race_frame++))
+                continue;
+            if (!disk_ui_is_visible()) {
+                g_scan_fallbacks++;
+                backoff = 60;
+            }
+        }
+        if (g_scan_request) {
+            // Back to the frame buffer from the next frame
+            g_scan_request = false;
+        } else if (backoff) {
+            backoff--;  // the frame buffer is drawn behind the beam, no sleep
+        } else {
+            sleep_ms(16);
+        }
+#else
         sleep_ms(16);
+#endif
         
         // Check if disk UI is visible
         bool ui_visible = disk_ui_is_visible();
@@ -301,12 +455,29 @@ static void core1_main(void) {
             // When the UI first becomes visible, seed the back buffer from the
             // current front buffer so the modal draws over a stable background.
             if (!was_ui_visible) {
-                memcpy(g_hdmi_back_buffer, g_hdmi_front_buffer, HDMI_WIDTH * HDMI_HEIGHT);
+                if (g_hdmi_back_buffer != g_hdmi_front_buffer)
+                    memcpy(g_hdmi_back_buffer, g_hdmi_front_buffer, HDMI_WIDTH * HDMI_HEIGHT);
+                else    // single buffer, it might hold an old frame
+                #if MII_VIDEO_SCANLINE
+                    scanline_behind();
+                #else
+                    mii_video_scale_to_hdmi(&g_mii.video, g_hdmi_back_buffer);
+                #endif
             }
             disk_ui_render(g_hdmi_back_buffer, HDMI_WIDTH, HDMI_HEIGHT);
         } else {
+            // The UI was drawn over both buffers, redraw them in full
+            if (was_ui_visible)
+                mii_video_full_refresh(&g_mii);
             mii_video_render(&g_mii);
+        #if MII_VIDEO_SCANLINE
+            // single buffer, it is on screen
+            scanline_behind();
+        #else
+            uint32_t render_start = time_us_32();
             mii_video_scale_to_hdmi(&g_mii.video, g_hdmi_back_buffer);
+            g_video_render_us += time_us_32() - render_start;
+        #endif
         }
 
         graphics_request_buffer_swap(g_hdmi_back_buffer);
@@ -359,6 +530,24 @@ static void load_rom(mii_t *mii, const uint8_t *rom, size_t len, uint16_t addr)
     mii_rom_register(&main_rom_struct);
     
     MII_DEBUG_PRINTF("Loaded %zu bytes ROM at $%04X\n", len, addr);
+
+    // Pre-decode the ROM code ($C100-$FFFF) once, the CPU uses it whenever
+    // these pages are mapped to the ROM bank. Optional, if we're short of RAM
+    // the CPU just decodes as usual.
+    static mii_cpu_decoded_t *rom_decoded = NULL;
+    if (!rom_decoded)
+        rom_decoded = malloc(MII_ROM_DECODED_SIZE * sizeof(*rom_decoded));
+    if (rom_decoded && addr + len == 0x10000 && addr <= MII_ROM_DECODED_BASE) {
+        mii_cpu_decode(rom + (MII_ROM_DECODED_BASE - addr),
+                MII_ROM_DECODED_SIZE, rom_decoded);
+        mii->rom_decoded = rom_decoded;
+        mii_rom_hook_install(mii);
+        mii_rom_hook_enable(mii, true);
+        MII_DEBUG_PRINTF("Pre-decoded ROM $%04X-$FFFF (%u bytes)\n",
+                MII_ROM_DECODED_BASE,
+                (unsigned)(MII_ROM_DECODED_SIZE * sizeof(*rom_decoded)));
+    } else
+        MII_DEBUG_PRINTF("ROM not pre-decoded\n");
 }
 
 // Load character ROM
@@ -387,6 +576,44 @@ static void load_char_rom(mii_t *mii, const uint8_t *rom, size_t len) {
     }
 }
 
+#if ENABLE_DEBUG_LOGS
+static uint64_t timer_bench_cb(mii_t *mii, void *param) {
+    (void)mii;
+    return (uint32_t)(uintptr_t)param;
+}
+
+/*
+ * Scheduler cost against the number of running timers, in the order a
+ * disk-booting game would add them: VBL, disk LSS, motor-off, 4 paddles.
+ * The timers are stepped the way I/O accesses do, every 4 cycles.
+ */
+static void timer_benchmark(void) {
+    static const uint32_t periods[] = { 4550, 32, 1000000, 2805, 2816, 2827, 2838 };
+    const uint32_t steps = 100000;
+    mii_t *mii = calloc(1, sizeof(*mii));
+    if (!mii)
+        return;
+    mii->timer.head = MII_TIMER_NONE;
+    mii->timer.next_event = UINT64_MAX;
+    for (int n = 0; n < (int)(sizeof(periods) / sizeof(periods[0])); n++) {
+        mii_timer_register(mii, timer_bench_cb, (void *)(uintptr_t)periods[n],
+                periods[n], "bench");
+        uint32_t start = time_us_32();
+        for (uint32_t i = 0; i < steps; i++) {
+            uint64_t total = mii->timer.last_run + 4;
+            if (total >= mii->timer.next_event)
+                mii_timer_run(mii, total - mii->timer.last_run);
+            else
+                mii->timer.last_run = total;
+        }
+        uint32_t us = time_us_32() - start;
+        MII_DEBUG_PRINTF("Timers: %d running, %lu ns per I/O access\n",
+                n + 1, (uint32_t)((uint64_t)us * 1000 / steps));
+    }
+    free(mii);
+}
+#endif
+
 int main() {
     // Overclock support: For speeds > 252 MHz, increase voltage first
 #if CPU_CLOCK_MHZ > 252
@@ -430,9 +657,16 @@ int main() {
     
     // Allocate HDMI framebuffer in SRAM (not PSRAM!) - DMA needs fast access
     MII_DEBUG_PRINTF("Allocating HDMI framebuffer in SRAM...\n");
+#if MII_VIDEO_SCANLINE
+    // Lines are raced from VRAM, a single buffer drawn in place is kept for
+    // the start screen, the disk UI and the fallback.
+    g_hdmi_front_buffer = (uint8_t *)malloc(HDMI_WIDTH * HDMI_HEIGHT);
+    g_hdmi_back_buffer = g_hdmi_front_buffer;
+#else
     // Double-buffer to prevent tearing: one buffer scanned out by HDMI DMA, one rendered by core1.
     g_hdmi_front_buffer = (uint8_t *)malloc(HDMI_WIDTH * HDMI_HEIGHT);
     g_hdmi_back_buffer = (uint8_t *)malloc(HDMI_WIDTH * HDMI_HEIGHT);
+#endif
     if (!g_hdmi_front_buffer || !g_hdmi_back_buffer) {
         MII_DEBUG_PRINTF("ERROR: Failed to allocate HDMI framebuffer\n");
         while (1) tight_loop_contents();
@@ -584,6 +818,9 @@ int main() {
     MII_DEBUG_PRINTF("Resetting emulator...\n");
     mii_reset(&g_mii, true);
     MII_DEBUG_PRINTF("Reset complete, state=%d\n", g_mii.state);
+#if ENABLE_DEBUG_LOGS
+    timer_benchmark();
+#endif
     
     // Start HDMI output
     MII_DEBUG_PRINTF("Starting HDMI output...\n");
@@ -656,6 +893,7 @@ int main() {
     // Performance metrics
     uint32_t total_cpu_time = 0;      // Time spent in CPU emulation
     uint32_t total_input_time = 0;    // Time spent polling input
+    uint32_t total_idle_time = 0;     // Time spent throttling to real time
     uint32_t total_cycles_run = 0;    // Actual cycles executed
     uint32_t metrics_start_us = time_us_32();
 
@@ -698,6 +936,9 @@ int main() {
         }
         
         process_keyboard();
+
+        // Breakpoint and watchpoint commands from the UART console
+        debug_console_poll(&g_mii);
         
         // Poll NES gamepad and update Apple II buttons
         nespad_read();
@@ -914,6 +1155,7 @@ int main() {
         uint32_t elapsed = frame_end - frame_start;
         if (elapsed < target_frame_us) {
             sleep_us((uint64_t)(target_frame_us - elapsed));
+            total_idle_time += target_frame_us - elapsed;
         }
         
         frame_count++;
@@ -971,6 +1213,98 @@ int main() {
                 avg_frame_us, avg_cpu_us, avg_input_us, avg_other_us);
             MII_DEBUG_PRINTF("Speed: %lu kHz (%lu%% of 1.023 MHz), %lu cyc/us\n",
                 effective_khz, percent_speed, cycles_per_cpu_us);
+            MII_DEBUG_PRINTF("Core: %s, %lu emulated cyc/s of CPU time\n",
+                MII_65C02_THREADED ? "threaded" : "switch",
+                total_cpu_time > 0 ?
+                    (uint32_t)((uint64_t)total_cycles_run * 1000000ULL / total_cpu_time) : 0);
+            MII_DEBUG_PRINTF("Run: %lu cpu_run calls per frame, %lu cycles past frame targets\n",
+                g_mii.run.calls / 300, g_mii.run.overshoot);
+            g_mii.run.calls = 0;
+            g_mii.run.overshoot = 0;
+            MII_DEBUG_PRINTF("Idle: %lu us per frame\n", total_idle_time / 300);
+        #if MII_65C02_IDLE_SKIP
+            MII_DEBUG_PRINTF("Polling: %lu loops, %lu cycles fast-forwarded\n",
+                mii_cpu_idle_stats.loops, mii_cpu_idle_stats.cycles);
+            memset(&mii_cpu_idle_stats, 0, sizeof(mii_cpu_idle_stats));
+        #endif
+        #if MII_65C02_LOOP_SKIP
+            MII_DEBUG_PRINTF("Delay: %lu loops, %lu cycles fast-forwarded\n",
+                mii_cpu_loop_stats.loops, mii_cpu_loop_stats.cycles);
+            memset(&mii_cpu_loop_stats, 0, sizeof(mii_cpu_loop_stats));
+        #endif
+            MII_DEBUG_PRINTF("RAMWorks: bank %u, %lu switches (%lu us, max %lu us)\n",
+                g_mii.ramworks.current, g_mii.ramworks.switches,
+                g_mii.ramworks.us, g_mii.ramworks.us_max);
+            g_mii.ramworks.switches = 0;
+            g_mii.ramworks.us = 0;
+            g_mii.ramworks.us_max = 0;
+            // PSRAM (and flash) traffic, a miss is a transfer on the QSPI bus
+            MII_DEBUG_PRINTF("XIP cache: %lu accesses, %lu misses\n",
+                xip_ctrl_hw->ctr_acc, xip_ctrl_hw->ctr_acc - xip_ctrl_hw->ctr_hit);
+            xip_ctrl_hw->ctr_acc = 0;
+            xip_ctrl_hw->ctr_hit = 0;
+            MII_DEBUG_PRINTF("Page maps: %lu rebuilt, %lu from cache\n",
+                g_mii.page_map.rebuild, g_mii.page_map.hit);
+            g_mii.page_map.rebuild = 0;
+            g_mii.page_map.hit = 0;
+            {   // busiest $C0xx addresses
+                uint8_t top[4];
+                for (int t = 0; t < 4; t++) {
+                    int best = -1;
+                    for (int i = 0; i < 256; i++) {
+                        bool seen = false;
+                        for (int u = 0; u < t; u++)
+                            seen |= top[u] == i;
+                        if (!seen && (best < 0 ||
+                                g_mii.io_count[i] > g_mii.io_count[best]))
+                            best = i;
+                    }
+                    top[t] = best;
+                }
+                MII_DEBUG_PRINTF("I/O: $C0%02X %lu, $C0%02X %lu, $C0%02X %lu, $C0%02X %lu\n",
+                    top[0], g_mii.io_count[top[0]], top[1], g_mii.io_count[top[1]],
+                    top[2], g_mii.io_count[top[2]], top[3], g_mii.io_count[top[3]]);
+                memset(g_mii.io_count, 0, sizeof(g_mii.io_count));
+            }
+            for (int i = 0; i < g_mii.rom_hook.count; i++) {
+                mii_rom_hook_t *h = &g_mii.rom_hook.hook[i];
+                MII_DEBUG_PRINTF("ROM hook %s: %lu calls, %lu cycles%s\n",
+                    h->name, h->calls, h->cycles,
+                    g_mii.rom_hook.enabled ? "" : " (off)");
+                h->calls = 0;
+                h->cycles = 0;
+            }
+            // cycles from mii_irq_raise() to the IRQ vector fetch; the
+            // cards that raise one (mii_mb.c etc) are desktop only so far
+            for (int i = 0; i < (int)sizeof(g_mii.irq.map) * 8; i++) {
+                if (!(g_mii.irq.map & (1 << i)))
+                    continue;
+                struct mii_irq_t *q = &g_mii.irq.irq[i];
+                MII_DEBUG_PRINTF("IRQ %s: %lu taken, latency %lu avg, %lu max cycles\n",
+                    q->name, q->taken, q->taken ? q->latency / q->taken : 0,
+                    q->latency_max);
+                q->taken = 0;
+                q->latency = 0;
+                q->latency_max = 0;
+            }
+            {   // core 1 renders, only lines with new VRAM data are redrawn
+                uint32_t renders = g_mii.video.renders;
+                MII_DEBUG_PRINTF("Video: %lu renders, %lu lines redrawn per frame, %lu us each\n",
+                    renders, renders ? g_mii.video.lines_drawn / renders : 0,
+                    renders ? g_video_render_us / renders : 0);
+                g_mii.video.renders = 0;
+                g_mii.video.lines_drawn = 0;
+                g_video_render_us = 0;
+            }
+        #if MII_VIDEO_SCANLINE
+            MII_DEBUG_PRINTF("Scanline: %lu frames raced, %lu underruns, worst line %lu us of %lu, %lu fallbacks\n",
+                g_scan_frames, g_scan_underruns, g_scan_worst_us, g_scan_budget_us,
+                g_scan_fallbacks);
+            g_scan_frames = 0;
+            g_scan_underruns = 0;
+            g_scan_worst_us = 0;
+            g_scan_fallbacks = 0;
+        #endif
             MII_DEBUG_PRINTF("PC: $%04X, Total cycles: %llu\n",
                 g_mii.cpu.PC, g_mii.cpu.total_cycle);
             MII_DEBUG_PRINTF("=============================\n\n");
@@ -979,6 +1313,7 @@ int main() {
              total_emu_time = 0;
              total_cpu_time = 0;
              total_input_time = 0;
+             total_idle_time = 0;
              total_cycles_run = 0;
              metrics_start_us = time_us_32();
          }
@@ -18,6 +18,9 @@
 #include "mii_65c02.h"
 #include "minipt.h"
 #include "debug_log.h"
+#if MII_RP2350
+#include "pico/time.h"
+#endif
 
 #if MII_65C02_DIRECT_ACCESS
 static mii_cpu_state_t
@@ -126,9 +129,7 @@ mii_dump_trace_state(
 //	if (s.sync)
 	{
 		uint8_t op[16];
-		for (int i = 0; i < 4; i++) {
-			mii_mem_access(mii, mii->cpu.PC + i, op + i, false, false);
-		}
+		mii_read_range(mii, mii->cpu.PC, op, 4);
 		mii_op_t d = mii_cpu_op[op[0]];
 		MII_DEBUG_PRINTF(" ");
 		char dis[32];
@@ -155,8 +156,7 @@ mii_dump_run_trace(
 		int idx = (mii->trace.idx + li) & (MII_PC_LOG_SIZE - 1);
 		uint16_t pc = mii->trace.log[idx];
 		uint8_t op[16];
-		for (int i = 0; i < 4; i++)
-			mii_mem_access(mii, pc + i, op + i, false, false);
+		mii_read_range(mii, pc, op, 4);
 //		mii_op_t d = mii_cpu_op[op[0]];
 		char dis[64];
 		mii_cpu_disasm_one(op, pc, dis, sizeof(dis),
@@ -167,6 +167,32 @@ mii_dump_run_trace(
 
 #define _SAME 0xf
 
+/* Writes to read only pages end up here, and are never read back */
+static uint8_t _mii_discard_page[256];
+static uint32_t _mii_discard_gen;
+
+static inline uint8_t *
+mii_page_ptr(
+		mii_t * mii,
+		uint8_t bank,
+		uint8_t page )
+{
+	mii_bank_t * b = &mii->bank[bank];
+	return b->mem + b->mem_offset + (page << 8) - b->base;
+}
+
+static inline uint32_t *
+mii_page_gen(
+		mii_t * mii,
+		uint8_t bank,
+		uint8_t page )
+{
+	mii_bank_t * b = &mii->bank[bank];
+	if (!b->gen)
+		return &_mii_discard_gen;
+	return &b->gen[(b->mem_offset + (page << 8) - b->base) >> 8];
+}
+
 static inline void
 mii_page_set(
 		mii_t * mii,
@@ -176,10 +202,16 @@ mii_page_set(
 		uint8_t end )
 {
 	for (int i = bank; i <= end; i++) {
-		if (read != _SAME)
+		if (read != _SAME) {
 			mii->mem[i].read = read;
-		if (write != _SAME)
+			mii->mem_read[i] = mii_page_ptr(mii, read, i);
+		}
+		if (write != _SAME) {
 			mii->mem[i].write = write;
+			mii->mem_write[i] = mii->bank[write].ro ?
+						_mii_discard_page : mii_page_ptr(mii, write, i);
+			mii->mem_write_gen[i] = mii_page_gen(mii, write, i);
+		}
 	}
 }
 
@@ -191,13 +223,46 @@ mii_sw(
 	return mii_bank_peek(&mii->bank[MII_BANK_SW], sw);
 }
 
+/*
+ * The soft switches the page map depends on; the others (PAGE2/HIRES
+ * without 80STORE, the slot ROM ones with INTCXROM, BSRPREWRITE...) are
+ * left out so they don't make maps that differ in name only.
+ */
+static uint32_t
+mii_page_map_key(
+		mii_t *mii)
+{
+	uint32_t sw = mii->sw_state;
+	uint32_t key = sw & (M_SWALTPZ | M_SWRAMRD | M_SWRAMWRT | M_SW80STORE |
+					M_BSRREAD | M_BSRWRITE | M_BSRPAGE2);
+	if (sw & M_SW80STORE)
+		key |= sw & (M_SWPAGE2 | M_SWHIRES);
+	if (mii->emu != MII_EMU_IIC) {
+		key |= sw & M_SWINTCXROM;
+		if (!(sw & M_SWINTCXROM))
+			key |= sw & (M_SWSLOTC3ROM | M_INTC8ROM);
+	}
+	// the RAMWorks bank only matters when some aux memory is mapped in
+	if (sw & (M_SWALTPZ | M_SWRAMRD | M_SWRAMWRT | M_SW80STORE))
+		key |= (uint32_t)mii->ramworks.current << 24;
+	return key;
+}
+
+/* Host memory behind a bank changed, none of the cached maps are valid */
 static void
-mii_page_table_update(
+mii_page_map_flush(
+		mii_t *mii)
+{
+	for (int i = 0; i < MII_PAGE_MAP_COUNT; i++)
+		mii->page_map.map[i].key = MII_PAGE_MAP_NONE;
+	mii->page_map.key = MII_PAGE_MAP_NONE;
+	mii->mem_dirty = true;
+}
+
+static void
+mii_page_table_build(
 		mii_t *mii)
 {
-	if (likely(!mii->mem_dirty))
-		return;
-	mii->mem_dirty = 0;
 	uint32_t sw = mii->sw_state;
 	bool altzp 		= SWW_GETSTATE(sw, SWALTPZ);
 	bool page2 		= SWW_GETSTATE(sw, SWPAGE2);
@@ -265,9 +330,114 @@ mii_page_table_update(
 			(altzp ? MII_BANK_AUX_BSR : MII_BANK_BSR) + bsrpage2 :
 					MII_BANK_ROM,
 				0xd0, 0xdf);
+	// the I/O page never takes the CPU fast path
+	mii->mem_read[0xc0] = mii->mem_write[0xc0] = NULL;
 }
 
-#if !MII_RP2350
+#if MII_RP2350
+/* Take the watched pages off the CPU fast path, see mii_debug_bp_set() */
+static void
+mii_debug_page_apply(
+		mii_t *mii)
+{
+	for (int i = 0; i < 256; i++) {
+		if (mii->debug.page[i] & MII_BP_R)
+			mii->mem_read[i] = NULL;
+		if (mii->debug.page[i] & MII_BP_W)
+			mii->mem_write[i] = NULL;
+	}
+}
+#endif
+
+static void
+mii_page_table_update(
+		mii_t *mii)
+{
+	if (likely(!mii->mem_dirty))
+		return;
+	mii->mem_dirty = 0;
+	uint32_t key = mii_page_map_key(mii);
+	if (key == mii->page_map.key)
+		return;
+	mii->page_map.key = key;
+	mii->page_map.stamp++;
+
+	mii_page_map_t *lru = &mii->page_map.map[0];
+	for (int i = 0; i < MII_PAGE_MAP_COUNT; i++) {
+		mii_page_map_t *m = &mii->page_map.map[i];
+		if (m->key == key) {
+			m->used = mii->page_map.stamp;
+			mii->page_map.hit++;
+			memcpy(mii->mem, m->mem, sizeof(mii->mem));
+			memcpy(mii->mem_read, m->read, sizeof(mii->mem_read));
+			memcpy(mii->mem_write, m->write, sizeof(mii->mem_write));
+			memcpy(mii->mem_write_gen, m->write_gen,
+					sizeof(mii->mem_write_gen));
+			goto done;
+		}
+		if (m->used < lru->used)
+			lru = m;
+	}
+	mii->page_map.rebuild++;
+	mii_page_table_build(mii);
+	lru->key = key;
+	lru->used = mii->page_map.stamp;
+	memcpy(lru->mem, mii->mem, sizeof(mii->mem));
+	memcpy(lru->read, mii->mem_read, sizeof(mii->mem_read));
+	memcpy(lru->write, mii->mem_write, sizeof(mii->mem_write));
+	memcpy(lru->write_gen, mii->mem_write_gen, sizeof(mii->mem_write_gen));
+done:
+	// the cached maps are kept without the watched pages
+#if MII_RP2350
+	if (unlikely(mii->debug.bp_map))
+		mii_debug_page_apply(mii);
+#endif
+	return;
+}
+
+#if MII_RP2350
+/* Banks 1 and up, past the disk images and the Disk II card */
+#define RAMWORKS_PSRAM_BASE		(0x11000000 + (2 * 1024 * 1024))
+#if MII_RAMWORKS_BANKS < 1 || MII_RAMWORKS_BANKS > 97
+#error MII_RAMWORKS_BANKS must be between 1 and 97 (6MB of PSRAM)
+#endif
+static uint32_t rp2350_ramworks_gen[0x100];	// shared by the PSRAM banks
+
+/*
+ * The PSRAM banks are mapped straight into the page table, so switching
+ * bank is a page map lookup and nothing is copied. Sharing the generation
+ * counters between the PSRAM banks only makes their users recheck a bit
+ * more often.
+ */
+static void
+mii_bank_update_ramworks(
+		mii_t *mii,
+		uint8_t bank)
+{
+	if (bank > 127 ||
+			!(mii->ramworks.avail[bank >> 5] & (1u << (bank & 31))))
+		bank = 0;
+	if (bank == mii->ramworks.current)
+		return;
+	uint32_t start = time_us_32();
+	uint32_t *gen = bank ? rp2350_ramworks_gen :
+						mii->bank[MII_BANK_AUX_BASE].gen;
+	mii->bank[MII_BANK_AUX].mem = mii->ramworks.bank[bank];
+	mii->bank[MII_BANK_AUX].gen = gen;
+	mii->bank[MII_BANK_AUX_BSR].mem = mii->ramworks.bank[bank];
+	mii->bank[MII_BANK_AUX_BSR].gen = gen;
+	mii->bank[MII_BANK_AUX_BSR_P2].mem = mii->ramworks.bank[bank];
+	mii->bank[MII_BANK_AUX_BSR_P2].gen = gen;
+	mii->ramworks.current = bank;
+	mii->mem_dirty = true;
+	mii_page_table_update(mii);
+	uint32_t us = time_us_32() - start;
+	mii->ramworks.switches++;
+	mii->ramworks.us += us;
+	if (us > mii->ramworks.us_max)
+		mii->ramworks.us_max = us;
+}
+#else
 static void
 mii_bank_update_ramworks(
 		mii_t *mii,
@@ -292,6 +462,8 @@ mii_bank_update_ramworks(
 	mii->bank[MII_BANK_AUX].mem = mii->ramworks.bank[bank];
 	mii->bank[MII_BANK_AUX_BSR].mem = mii->ramworks.bank[bank];
 	mii->bank[MII_BANK_AUX_BSR_P2].mem = mii->ramworks.bank[bank];
+	mii->ramworks.current = bank;
+	mii->mem_dirty = true;	// the bank is part of the page map key
 }
 #endif
 
@@ -299,15 +471,20 @@ void
 mii_set_sw_override(
 		mii_t *mii,
 		uint16_t sw_addr,
-		mii_bank_access_cb cb,
+		mii_io_read_p read,
+		mii_io_write_p write,
 		void *param)
 {
-	if (!mii->soft_switches_override)
-		mii->soft_switches_override = calloc(256,
-				sizeof(*mii->soft_switches_override));
-	sw_addr &= 0xff;
-	mii->soft_switches_override[sw_addr].cb = cb;
-	mii->soft_switches_override[sw_addr].param = param;
+	mii_io_t * io = &mii->io[sw_addr & 0xff];
+	if (read) {
+		io->read = read;
+		io->read_param = param;
+	}
+	if (write) {
+		io->write = write;
+		io->write_param = param;
+	}
+	io->flags |= MII_IO_OVERRIDE;
 }
 
 /*
@@ -366,37 +543,11 @@ mii_access_soft_switches(
 	if (!(addr >= 0xc000 && addr <= 0xc0ff))
 		return false;
 	bool res = false;
-	uint8_t on = 0;
 	mii_bank_t * sw = &mii->bank[MII_BANK_SW];
 	const uint16_t sw_save = mii->sw_state;
 
-	/*
-	 * This allows driver (titan accelerator etc) to have their own
-	 * soft switches, and override/supplement any default ones.
-	 */
-	if (mii->soft_switches_override && mii->soft_switches_override[addr & 0xff].cb) {
-		res = mii->soft_switches_override[addr & 0xff].cb(
-					sw, mii->soft_switches_override[addr & 0xff].param,
-					addr, byte, write);
-		if (res)
-			return res;
-	}
+	// slots ($c090-$c0ff) and overrides are dispatched by mii->io[]
 	switch (addr) {
-		case 0xc090 ... 0xc0ff: {
-			res = true;
-			int slot = ((addr >> 4) & 7) - 1;
-#if 0
-			printf("SLOT %d addr %04x write %d %02x drv %s\n",
-				slot + 1, addr, write, *byte,
-				mii->slot[slot].drv ? mii->slot[slot].drv->name : "none");
-#endif
-			if (mii->slot[slot].drv) {
-				on = mii->slot[slot].drv->access(mii,
-							&mii->slot[slot], addr, *byte, write);
-				if (!write)
-					*byte = on;
-			}
-		}	break;
 /*
  SATHER-SATHER-SATHER-SATHER-SATHER-SATHER-SATHER-SATHER-SATHER-SATHER
 
@@ -474,6 +625,9 @@ mii_access_soft_switches(
 					MII_DEBUG_PRINTF("BANKING IIC FIRST ROM\n");
 					mii->bank[MII_BANK_ROM].mem = (uint8_t*)mii->rom->rom;
 				}
+				mii->rom_decoded = NULL;	// not for that ROM
+				mii_page_map_flush(mii);
+				mii_page_table_update(mii);
 				return res;
 				break;
 		}
@@ -521,7 +675,6 @@ mii_access_soft_switches(
 				SW_SETSTATE(mii, SWSLOTC3ROM, addr & 1);
 				mii_bank_poke(sw, SWSLOTC3ROM, (addr & 1) << 7);
 				break;
-#if !MII_RP2350
 			case SWRAMWORKS_BANK:	// 0xc073
 			/*
 			 * From the reading, it seems only Proterm ever assumes these
@@ -535,7 +688,6 @@ mii_access_soft_switches(
 				mii_bank_poke(sw, SWRAMWORKS_BANK, *byte);
 				mii_bank_update_ramworks(mii, *byte);
 				break;
-#endif
 		}
 		mii->mem_dirty += sw_save != mii->sw_state;
 	} else {
@@ -656,6 +808,230 @@ mii_keypress(
 	mii_bank_poke(sw, SWKBD, key & 0x7f);
 }
 
+/* Plain access to whatever bank is mapped at addr */
+static void
+_mii_mem_bank_access(
+		mii_t *mii,
+		uint16_t addr,
+		uint8_t * d,
+		bool wr)
+{
+	uint8_t page = addr >> 8;
+	if (wr) {
+		uint8_t m = mii->mem[page].write;
+		mii_bank_t * b = &mii->bank[m];
+		if (!b->ro)
+			mii_bank_write(b, addr, d, 1);
+		else {
+			mii_bank_access(b, addr, d, 1, true);
+		}
+	} else {
+		uint8_t m = mii->mem[page].read;
+		mii_bank_t * b = &mii->bank[m];
+		*d = mii_bank_peek(b, addr);
+	}
+}
+
+/*
+ * $c0xx I/O handlers. The default ones go through the keyboard, video and
+ * soft switch code in turn, the first one to handle the address wins,
+ * otherwise it's the soft switch page itself. The busiest switches have
+ * their own handlers, doing the same thing without the tests.
+ */
+static uint8_t
+_mii_io_read_default(
+		mii_t *mii,
+		void *param,
+		uint16_t addr,
+		uint8_t byte)
+{
+	bool done =
+		mii_access_keyboard(mii, addr, &byte, false) ||
+		mii_access_video(mii, addr, &byte, false) ||
+		mii_access_soft_switches(mii, addr, &byte, false);
+	if (!done)
+		_mii_mem_bank_access(mii, addr, &byte, false);
+	return byte;
+}
+
+static void
+_mii_io_write_default(
+		mii_t *mii,
+		void *param,
+		uint16_t addr,
+		uint8_t byte)
+{
+	bool done =
+		mii_access_keyboard(mii, addr, &byte, true) ||
+		mii_access_video(mii, addr, &byte, true) ||
+		mii_access_soft_switches(mii, addr, &byte, true);
+	if (!done)
+		_mii_mem_bank_access(mii, addr, &byte, true);
+}
+
+// $c000 read: keyboard data, with the strobe
+static uint8_t
+_mii_io_read_kbd(
+		mii_t *mii,
+		void *param,
+		uint16_t addr,
+		uint8_t byte)
+{
+	return mii_bank_peek(&mii->bank[MII_BANK_SW], SWAKD);
+}
+
+// $c010: clears the keyboard strobe
+static uint8_t
+_mii_io_read_akd(
+		mii_t *mii,
+		void *param,
+		uint16_t addr,
+		uint8_t byte)
+{
+	mii_access_keyboard(mii, addr, &byte, false);
+	return byte;
+}
+
+static void
+_mii_io_write_akd(
+		mii_t *mii,
+		void *param,
+		uint16_t addr,
+		uint8_t byte)
+{
+	mii_access_keyboard(mii, addr, &byte, true);
+}
+
+// $c061-$c063: push buttons, writes are ignored
+static uint8_t
+_mii_io_read_button(
+		mii_t *mii,
+		void *param,
+		uint16_t addr,
+		uint8_t byte)
+{
+	return mii_bank_peek(&mii->bank[MII_BANK_SW], addr);
+}
+
+static uint8_t
+_mii_io_read_speaker(
+		mii_t *mii,
+		void *param,
+		uint16_t addr,
+		uint8_t byte)
+{
+	mii_speaker_click(&mii->speaker);
+	return byte;
+}
+
+static void
+_mii_io_write_speaker(
+		mii_t *mii,
+		void *param,
+		uint16_t addr,
+		uint8_t byte)
+{
+	mii_speaker_click(&mii->speaker);
+}
+
+// $c090-$c0ff, the slot is found from the address
+static uint8_t
+_mii_io_read_slot(
+		mii_t *mii,
+		void *param,
+		uint16_t addr,
+		uint8_t byte)
+{
+	mii_slot_t * slot = &mii->slot[((addr >> 4) & 7) - 1];
+	return slot->drv->access(mii, slot, addr, byte, false);
+}
+
+static void
+_mii_io_write_slot(
+		mii_t *mii,
+		void *param,
+		uint16_t addr,
+		uint8_t byte)
+{
+	mii_slot_t * slot = &mii->slot[((addr >> 4) & 7) - 1];
+	slot->drv->access(mii, slot, addr, byte, true);
+}
+
+// empty slot
+static uint8_t
+_mii_io_read_none(
+		mii_t *mii,
+		void *param,
+		uint16_t addr,
+		uint8_t byte)
+{
+	return byte;
+}
+
+static void
+_mii_io_write_none(
+		mii_t *mii,
+		void *param,
+		uint16_t addr,
+		uint8_t byte)
+{
+}
+
+static void
+_mii_io_set(
+		mii_t *mii,
+		uint16_t addr,
+		mii_io_read_p read,
+		mii_io_write_p write)
+{
+	mii_io_t * io = &mii->io[addr & 0xff];
+	io->read = read;
+	io->write = write;
+	io->read_param = io->write_param = NULL;
+	io->flags = 0;
+}
+
+static void
+mii_io_init(
+		mii_t *mii)
+{
+	for (int i = 0; i < 0x90; i++)
+		_mii_io_set(mii, 0xc000 + i,
+				_mii_io_read_default, _mii_io_write_default);
+	for (int i = 0x90; i < 0x100; i++)
+		_mii_io_set(mii, 0xc000 + i, _mii_io_read_none, _mii_io_write_none);
+	_mii_io_set(mii, SWKBD, _mii_io_read_kbd, _mii_io_write_default);
+	_mii_io_set(mii, SWAKD, _mii_io_read_akd, _mii_io_write_akd);
+	_mii_io_set(mii, SWSPEAKER, _mii_io_read_speaker, _mii_io_write_speaker);
+	for (int i = 0x61; i <= 0x63; i++)
+		_mii_io_set(mii, 0xc000 + i, _mii_io_read_button, _mii_io_write_none);
+}
+
+void
+mii_io_slot_attach(
+		mii_t *mii,
+		mii_slot_t *slot)
+{
+	uint16_t base = 0xc090 + ((slot - mii->slot) << 4);
+	for (int i = 0; i < 16; i++)
+		_mii_io_set(mii, base + i, _mii_io_read_slot, _mii_io_write_slot);
+}
+
+static inline void
+_mii_io_access(
+		mii_t *mii,
+		uint16_t addr,
+		uint8_t * d,
+		bool wr)
+{
+	mii_io_t * io = &mii->io[addr & 0xff];
+	mii->io_count[addr & 0xff]++;
+	if (wr)
+		io->write(mii, io->write_param, addr, *d);
+	else
+		*d = io->read(mii, io->read_param, addr, *d);
+}
+
 #if !MII_RP2350
 /* ramworks came populated in chunks, this duplicates these rows of chips */
 #define B(x) ((unsigned __int128)1ULL << (x))
@@ -685,6 +1061,8 @@ static uint8_t rp2350_main_mem[0x10000];  // 64KB main memory
 static uint8_t rp2350_aux_mem[0x10000];   // 64KB aux memory (full Apple IIe aux)
 static uint8_t rp2350_sw_mem[256];        // Soft switch area
 static uint8_t rp2350_card_rom[0x0F00];   // Card ROM area ($C100-$CFFF = 15 pages)
+static uint32_t rp2350_main_gen[0x100];   // Write generation of each main page
+static uint32_t rp2350_aux_gen[0x100];    // Write generation of each aux page
 
 void
 mii_init(
@@ -694,6 +1072,8 @@ mii_init(
 	memset(mii, 0, sizeof(*mii));
 	mii->speed = MII_SPEED_NTSC;
 	mii->timer.map = 0;
+	mii->timer.head = MII_TIMER_NONE;
+	mii->timer.next_event = UINT64_MAX;
 
 	MII_DEBUG_PRINTF("  mii_init: setting up banks...\n");
 	for (int i = 0; i < MII_BANK_COUNT; i++)
@@ -702,19 +1082,26 @@ mii_init(
 	// On RP2350, use static memory arrays instead of malloc
 	mii->bank[MII_BANK_MAIN].mem = rp2350_main_mem;
 	mii->bank[MII_BANK_MAIN].no_alloc = 1;
+	mii->bank[MII_BANK_MAIN].gen = rp2350_main_gen;
 	mii->bank[MII_BANK_BSR].mem = rp2350_main_mem;
 	mii->bank[MII_BANK_BSR].no_alloc = 1;
+	mii->bank[MII_BANK_BSR].gen = rp2350_main_gen;
 	mii->bank[MII_BANK_BSR_P2].mem = rp2350_main_mem;
 	mii->bank[MII_BANK_BSR_P2].no_alloc = 1;
+	mii->bank[MII_BANK_BSR_P2].gen = rp2350_main_gen;
 	
 	mii->bank[MII_BANK_AUX].mem = rp2350_aux_mem;
 	mii->bank[MII_BANK_AUX].no_alloc = 1;
+	mii->bank[MII_BANK_AUX].gen = rp2350_aux_gen;
 	mii->bank[MII_BANK_AUX_BASE].mem = rp2350_aux_mem;
 	mii->bank[MII_BANK_AUX_BASE].no_alloc = 1;
+	mii->bank[MII_BANK_AUX_BASE].gen = rp2350_aux_gen;
 	mii->bank[MII_BANK_AUX_BSR].mem = rp2350_aux_mem;
 	mii->bank[MII_BANK_AUX_BSR].no_alloc = 1;
+	mii->bank[MII_BANK_AUX_BSR].gen = rp2350_aux_gen;
 	mii->bank[MII_BANK_AUX_BSR_P2].mem = rp2350_aux_mem;
 	mii->bank[MII_BANK_AUX_BSR_P2].no_alloc = 1;
+	mii->bank[MII_BANK_AUX_BSR_P2].gen = rp2350_aux_gen;
 	
 	mii->bank[MII_BANK_SW].mem = rp2350_sw_mem;
 	mii->bank[MII_BANK_SW].no_alloc = 1;
@@ -738,7 +1125,22 @@ mii_init(
 	// when firmware probes/executes slot ROM entry points.
 	memset(rp2350_card_rom, 0xFF, sizeof(rp2350_card_rom));
 
+	// RAMWorks bank 0 is the aux memory above, the others are in PSRAM;
+	// cleared here, not on their first $c073 write, mid guest code
+	MII_DEBUG_PRINTF("    Clearing RAMWorks PSRAM banks (%dKB)\n",
+			(MII_RAMWORKS_BANKS - 1) * 64);
+	mii->ramworks.bank[0] = rp2350_aux_mem;
+	for (int i = 0; i < MII_RAMWORKS_BANKS; i++) {
+		if (i) {
+			mii->ramworks.bank[i] =
+					(uint8_t *)RAMWORKS_PSRAM_BASE + ((i - 1) << 16);
+			memset(mii->ramworks.bank[i], 0, 0x10000);
+		}
+		mii->ramworks.avail[i >> 5] |= 1u << (i & 31);
+	}
+
 	mii->cpu.trap = MII_TRAP;
+	mii_io_init(mii);
 	
 	// Skip desktop-specific subsystems on RP2350:
 	// - mii_dd_system_init (disk drive)
@@ -764,6 +1166,9 @@ mii_init(
 }
 
 #else
+static uint32_t mii_main_gen[0x100];	// Write generation of each main page
+static uint32_t mii_aux_gen[0x100];		// ... aux, shared by the RAMWorks banks
+
 // Original desktop version
 void
 mii_init(
@@ -772,6 +1177,8 @@ mii_init(
 	memset(mii, 0, sizeof(*mii));
 	mii->speed = MII_SPEED_NTSC;
 	mii->timer.map = 0;
+	mii->timer.head = MII_TIMER_NONE;
+	mii->timer.next_event = UINT64_MAX;
 
 	for (int i = 0; i < MII_BANK_COUNT; i++)
 		mii->bank[i] = _mii_banks_init[i];
@@ -782,10 +1189,15 @@ mii_init(
 	mii->bank[MII_BANK_MAIN].mem = mem;
 	mii->bank[MII_BANK_BSR].mem = mem;
 	mii->bank[MII_BANK_BSR_P2].mem = mem;
+	for (int i = MII_BANK_MAIN; i <= MII_BANK_BSR_P2; i++)
+		mii->bank[i].gen = mii_main_gen;
+	for (int i = MII_BANK_AUX_BASE; i <= MII_BANK_AUX_BSR_P2; i++)
+		mii->bank[i].gen = mii_aux_gen;
 	mii->ramworks.avail = 0;
 	mii_bank_update_ramworks(mii, 0);
 
 	mii->cpu.trap = MII_TRAP;
+	mii_io_init(mii);
 	// these are called once, regardless of reset
 	mii_dd_system_init(mii, &mii->dd);
 	mii_analog_init(mii, &mii->analog);
@@ -871,6 +1283,7 @@ mii_reset(
 		mii->rom = mii_rom_get("iic");
 	}
 	mii->bank[MII_BANK_ROM].mem = (uint8_t*)mii->rom->rom;
+	mii_page_map_flush(mii);
 	mii->state = MII_RUNNING;
 	mii->cpu_state.reset = 1;
 	mii_bank_t * main = &mii->bank[MII_BANK_MAIN];
@@ -891,6 +1304,7 @@ mii_reset(
 	mii_bank_poke(sw, SW80COL, 0);
 	mii_bank_poke(sw, SWINTCXROM, 0x80);
 	mii_bank_poke(sw, SWRAMWORKS_BANK, 0);
+	mii_bank_update_ramworks(mii, 0);
 	// Clear video soft switches on reset (fixes games checking mode on boot)
 	mii_bank_poke(sw, SWTEXT, 0);
 	mii_bank_poke(sw, SWMIXED, 0);
@@ -940,58 +1354,15 @@ mii_mem_access(
 	if (!do_sw && addr >= 0xc000 && addr <= 0xc0ff && addr != 0xcfff)
 		return;
 	
-#ifdef MII_RP2350
-	// Fast path: check address range first to minimize function calls
-	// Slot I/O: $C090-$C0FF - most frequent during disk access
-	if (addr >= 0xc090 && addr <= 0xc0ff) {
-		int slot = ((addr >> 4) & 7) - 1;
-		if (mii->slot[slot].drv) {
-			uint8_t on = mii->slot[slot].drv->access(mii,
-						&mii->slot[slot], addr, *d, wr);
-			if (!wr)
-				*d = on;
-		}
+	if ((addr & 0xff00) == 0xc000) {
+		_mii_io_access(mii, addr, d, wr);
 		return;
 	}
-	
-	// Keyboard: $C000-$C01F and Apple/joystick buttons: $C061-$C063
-	uint8_t low = addr & 0xff;
-	if (low <= 0x1f || (low >= 0x61 && low <= 0x63)) {
-		if (mii_access_keyboard(mii, addr, d, wr))
-			return;
-	}
-	
-	// Check other handlers
-	uint8_t done =
-		_mii_deselect_cXrom(mii, addr, d, wr) ||
-		mii_access_video(mii, addr, d, wr) ||
-		mii_access_soft_switches(mii, addr, d, wr);
-	if (done)
+	// the video code tracks writes to the video memory
+	if (_mii_deselect_cXrom(mii, addr, d, wr) ||
+			mii_access_video(mii, addr, d, wr))
 		return;
-#else
-	uint8_t done =
-		_mii_deselect_cXrom(mii, addr, d, wr) ||
-		mii_access_keyboard(mii, addr, d, wr) ||
-		mii_access_video(mii, addr, d, wr) ||
-		mii_access_soft_switches(mii, addr, d, wr);
-	if (done)
-		return;
-#endif
-
-	uint8_t page = addr >> 8;
-	if (wr) {
-		uint8_t m = mii->mem[page].write;
-		mii_bank_t * b = &mii->bank[m];
-		if (!b->ro)
-			mii_bank_write(b, addr, d, 1);
-		else {
-			mii_bank_access(b, addr, d, 1, true);
-		}
-	} else {
-		uint8_t m = mii->mem[page].read;
-		mii_bank_t * b = &mii->bank[m];
-		*d = mii_bank_peek(b, addr);
-	}
+	_mii_mem_bank_access(mii, addr, d, wr);
 }
 
 static void
@@ -1036,6 +1407,60 @@ mii_register_trap(
 	return 0xff;
 }
 
+/*
+ * Remove/insert timer 'i' from the running list, that is kept sorted by
+ * deadline (ties in timer order), and update the cached next_event.
+ */
+static void
+_mii_timer_unlink(
+		mii_t *mii,
+		uint8_t i)
+{
+	if (!mii->timer.timers[i].running)
+		return;
+	mii->timer.timers[i].running = 0;
+	uint8_t *p = &mii->timer.head;
+	while (*p != i)
+		p = &mii->timer.timers[*p].next;
+	*p = mii->timer.timers[i].next;
+	mii->timer.next_event = mii->timer.head == MII_TIMER_NONE ? UINT64_MAX :
+			mii->timer.timers[mii->timer.head].deadline;
+}
+
+static void
+_mii_timer_link(
+		mii_t *mii,
+		uint8_t i,
+		uint64_t deadline)
+{
+	mii->timer.timers[i].deadline = deadline;
+	mii->timer.timers[i].running = 1;
+	uint8_t *p = &mii->timer.head;
+	while (*p != MII_TIMER_NONE &&
+			(mii->timer.timers[*p].deadline < deadline ||
+			(mii->timer.timers[*p].deadline == deadline && *p < i)))
+		p = &mii->timer.timers[*p].next;
+	mii->timer.timers[i].next = *p;
+	*p = i;
+	mii->timer.next_event = mii->timer.timers[mii->timer.head].deadline;
+	// if the CPU is running, make it stop in time for this one
+	if (mii->timer.next_event < mii->cpu.cycle_limit)
+		mii->cpu.cycle_limit = mii->timer.next_event;
+}
+
+/* timers are relative to last_run, like they were when counting down */
+static void
+_mii_timer_arm(
+		mii_t *mii,
+		uint8_t i,
+		int64_t when)
+{
+	_mii_timer_unlink(mii, i);
+	mii->timer.timers[i].when = when;
+	if (when > 0)
+		_mii_timer_link(mii, i, mii->timer.last_run + when);
+}
+
 uint8_t
 mii_timer_register(
 		mii_t *mii,
@@ -1052,8 +1477,8 @@ mii_timer_register(
 	mii->timer.map |= 1ull << i;
 	mii->timer.timers[i].cb = cb;
 	mii->timer.timers[i].param = param;
-	mii->timer.timers[i].when = when;
 	mii->timer.timers[i].name = name;
+	_mii_timer_arm(mii, i, when);
 	return i;
 }
 
@@ -1064,6 +1489,9 @@ mii_timer_get(
 {
 	if (timer_id >= (int)sizeof(mii->timer.map) * 8)
 		return 0;
+	if (mii->timer.timers[timer_id].running)
+		return (int64_t)(mii->timer.timers[timer_id].deadline -
+							mii->timer.last_run);
 	return mii->timer.timers[timer_id].when;
 }
 
@@ -1075,59 +1503,52 @@ mii_timer_set(
 {
 	if (timer_id >= (int)sizeof(mii->timer.map) * 8)
 		return -1;
-	mii->timer.timers[timer_id].when = when;
+	_mii_timer_arm(mii, timer_id, when);
 	return 0;
 }
 
+/*
+ * Advance the timers by 'cycles' since last_run, and call the ones that
+ * are due, earliest first. This is a no-op unless next_event is reached.
+ */
 void
 mii_timer_run(
 		mii_t *mii,
 		uint64_t cycles)
 {
-#ifdef MII_RP2350
-	// Process ALL active timers
-	uint64_t timer = mii->timer.map;
-	if (!timer) return;
-	
-	for (int i = 0; i < 64 && timer; i++) {
-		if (timer & (1ull << i)) {
-			timer &= ~(1ull << i);
-			if (mii->timer.timers[i].when > 0) {
-				mii->timer.timers[i].when -= cycles;
-				if (mii->timer.timers[i].when <= 0) {
-					if (mii->timer.timers[i].cb) {
-						uint64_t period = mii->timer.timers[i].cb(mii,
-								mii->timer.timers[i].param);
-						// If timer got very behind (missed multiple periods),
-						// just reset to the period instead of adding to huge negative
-						if (mii->timer.timers[i].when < -(int64_t)period) {
-							mii->timer.timers[i].when = period;
-						} else {
-							mii->timer.timers[i].when += period;
-						}
-					} else {
-						// Timer with no callback (like paddle timers) - just stop at 0
-						mii->timer.timers[i].when = 0;
-					}
-				}
-			}
+	uint64_t now = mii->timer.last_run + cycles;
+	// callbacks expect mii_timer_get() to return how late they are
+	mii->timer.last_run = now;
+	while (mii->timer.next_event <= now) {
+		uint8_t i = mii->timer.head;
+		struct mii_timer_t *t = &mii->timer.timers[i];
+		uint64_t deadline = t->deadline;
+		if (!t->cb) {
+			// Timer with no callback (like paddle timers) - just stop at 0
+			_mii_timer_unlink(mii, i);
+			t->when = 0;
+			continue;
 		}
-	}
-#else
-	uint64_t timer = mii->timer.map;
-	while (timer) {
-		int i = ffsll(timer) - 1;
-		timer &= ~(1ull << i);
-		if (mii->timer.timers[i].when > 0) {
-			mii->timer.timers[i].when -= cycles;
-			if (mii->timer.timers[i].when <= 0) {
-				if (mii->timer.timers[i].cb)
-					mii->timer.timers[i].when += mii->timer.timers[i].cb(mii,
-							mii->timer.timers[i].param);
-			}
+		uint64_t period = t->cb(mii, t->param);
+		// the callback might have re-armed (or stopped) its own timer
+		if (!t->running || t->deadline != deadline)
+			continue;
+		_mii_timer_unlink(mii, i);
+		if (!period) {
+			t->when = (int64_t)(deadline - now);
+			continue;
 		}
+		// If timer got very behind (missed multiple periods),
+		// just reset to the period instead of catching up
+		if (now - deadline > period)
+			deadline = now + period;
+		else
+			deadline += period;
+		// never due twice in the same run
+		if (deadline <= now)
+			deadline = now + 1;
+		_mii_timer_link(mii, i, deadline);
 	}
-#endif
 }
 
 uint8_t
@@ -1157,6 +1578,7 @@ mii_irq_unregister(
 	if (irq_id >= (int)sizeof(mii->irq.map) * 8)
 		return;
 	mii->irq.map &= ~(1 << irq_id);
+	mii->cpu.irq_pending &= ~(1 << irq_id);
 }
 
 void
@@ -1166,9 +1588,11 @@ mii_irq_raise(
 {
 	if (irq_id >= (int)sizeof(mii->irq.map) * 8)
 		return;
-	if (!(mii->irq.raised & (1 << irq_id)))
+	if (!(mii->cpu.irq_pending & (1 << irq_id))) {
 		mii->irq.irq[irq_id].count++;
-	mii->irq.raised |= 1 << irq_id;
+		mii->irq.irq[irq_id].raised = mii->cpu.total_cycle + mii->cpu.cycle;
+	}
+	mii->cpu.irq_pending |= 1 << irq_id;
 }
 
 void
@@ -1178,7 +1602,17 @@ mii_irq_clear(
 {
 	if (irq_id >= (int)sizeof(mii->irq.map) * 8)
 		return;
-	mii->irq.raised &= ~(1 << irq_id);
+	// the handler clears it, so the vector fetch, if any, was before
+	if ((mii->cpu.irq_pending & (1 << irq_id)) &&
+			mii->cpu.irq_vector_cycle >= mii->irq.irq[irq_id].raised) {
+		uint32_t latency = mii->cpu.irq_vector_cycle -
+								mii->irq.irq[irq_id].raised;
+		mii->irq.irq[irq_id].taken++;
+		mii->irq.irq[irq_id].latency += latency;
+		if (latency > mii->irq.irq[irq_id].latency_max)
+			mii->irq.irq[irq_id].latency_max = latency;
+	}
+	mii->cpu.irq_pending &= ~(1 << irq_id);
 }
 
 
@@ -1188,14 +1622,78 @@ mii_irq_clear(
 
 #if MII_RP2350
 /*
- * Optimized CPU access callback for RP2350.
- * This is the HOT PATH - called for every single memory access!
- * Optimizations:
- * 1. No debug/breakpoint support (saves loop iteration)
- * 2. No trace logging (saves memory writes)
- * 3. Timer run batched every N cycles
- * 4. Fast path for RAM and ROM (direct memory access)
- * 5. Only I/O ($C000-$C0FF) goes through slow path
+ * An access to a watched page; stop the CPU after this instruction if it
+ * is one of the watchpoints. The CPU state is past the instruction by
+ * then, so the access is kept for whoever reports it. Opcode and operand
+ * fetches aren't reads, the operand one is at the PC the CPU just stepped
+ * over.
+ */
+static void
+_mii_debug_bp_check(
+		mii_t *mii,
+		mii_cpu_state_t access)
+{
+	for (int i = 0; i < (int)sizeof(mii->debug.bp_map) * 8; i++) {
+		if (!(mii->debug.bp_map & (1 << i)))
+			continue;
+		uint8_t kind = mii->debug.bp[i].kind;
+		if (access.addr < mii->debug.bp[i].addr ||
+				access.addr >= mii->debug.bp[i].addr + mii->debug.bp[i].size)
+			continue;
+		bool fetch = access.sync ||
+				access.addr == (uint16_t)(mii->cpu.PC - 1);
+		if (!((kind & MII_BP_R) && !access.w && !fetch) &&
+				!((kind & MII_BP_W) && access.w))
+			continue;
+		mii->debug.bp[i].kind |= MII_BP_HIT;
+		mii->debug.hit = access;
+		mii->cpu.instruction_run = 0;
+		mii->state = MII_STOPPED;
+		if (!(kind & MII_BP_STICKY))
+			mii_debug_bp_clear(mii, i);
+	}
+}
+
+/*
+ * Stop before the instruction at PC if it has a breakpoint; not when
+ * resuming from that same stop, or it would never run.
+ */
+static bool
+_mii_debug_pc_check(
+		mii_t *mii,
+		uint64_t now)
+{
+	uint16_t pc = mii->cpu.PC;
+	bool stop = false;
+
+	if (now == mii->debug.pc_stop)
+		return false;
+	for (int i = 0; i < (int)sizeof(mii->debug.pc_map) * 8; i++) {
+		if (!(mii->debug.pc_map & (1 << i)))
+			continue;
+		if (pc < mii->debug.bp[i].addr ||
+				pc >= mii->debug.bp[i].addr + mii->debug.bp[i].size)
+			continue;
+		mii->debug.bp[i].kind |= MII_BP_HIT;
+		mii->debug.hit = (mii_cpu_state_t){ .addr = pc, .sync = 1,
+				.data = mii_page_ptr(mii, mii->mem[pc >> 8].read,
+										pc >> 8)[pc & 0xff] };
+		mii->debug.pc_stop = now;
+		mii->state = MII_STOPPED;
+		stop = true;
+		if (!(mii->debug.bp[i].kind & MII_BP_STICKY))
+			mii_debug_bp_clear(mii, i);
+	}
+	return stop;
+}
+
+/*
+ * CPU access callback for RP2350, the CPU only calls it for pages that
+ * have no host pointer in mem_read[]/mem_write[]:
+ * 1. I/O ($C000-$C0FF)
+ * 2. Pages with a breakpoint or watchpoint, see mii_debug_bp_set(); the
+ *    others run at full speed
+ * No trace logging, and timers are run by the CPU before calling.
  */
 static mii_cpu_state_t
 _mii_cpu_direct_access_cb(
@@ -1219,34 +1717,25 @@ _mii_cpu_direct_access_cb(
 	}
 #endif
 	
-	// Fast path for non-I/O memory (RAM < $C000 or ROM $C100-$FFFF)
-	// Only $C000-$C0FF is I/O that needs special handling
-	if (likely(page != 0xC0)) {
+	// Only watched pages come here, besides $C000-$C0FF; they have no
+	// host pointer in mem_read[]/mem_write[], so go through the banks
+	if (unlikely(page != 0xC0)) {
+		if (mii->debug.page[page])
+			_mii_debug_bp_check(mii, access);
 		if (access.w) {
-			// Write
-			uint8_t m = mii->mem[page].write;
-			mii_bank_t *b = &mii->bank[m];
-			if (likely(!b->ro)) {
-				// Direct memory write - bypass mii_bank_write overhead
-				uint32_t phy = b->mem_offset + addr - b->base;
-				b->mem[phy] = access.data;
-			}
-		} else {
-			// Read
-			uint8_t m = mii->mem[page].read;
-			mii_bank_t *b = &mii->bank[m];
-			// Direct memory read - bypass mii_bank_peek overhead
-			uint32_t phy = b->mem_offset + addr - b->base;
-			mii->cpu_state.data = b->mem[phy];
-		}
+			uint8_t w = mii->mem[page].write;
+			uint8_t *m = mii->bank[w].ro ?
+							_mii_discard_page : mii_page_ptr(mii, w, page);
+			m[addr & 0xff] = access.data;
+			(*mii->mem_write_gen[page])++;
+		} else
+			mii->cpu_state.data = mii_page_ptr(mii,
+							mii->mem[page].read, page)[addr & 0xff];
 	} else {
 		// Slow path for I/O only ($C000-$C0FF)
-		mii_mem_access(mii, addr, &mii->cpu_state.data, access.w, true);
+		_mii_io_access(mii, addr, &mii->cpu_state.data, access.w);
 	}
 	
-	// IRQ check
-	mii->cpu_state.irq = mii->cpu_state.irq | !!mii->irq.raised;
-	
 	return mii->cpu_state;
 }
 #else
@@ -1297,7 +1786,6 @@ _mii_cpu_direct_access_cb(
 		}
 	}
 	mii_mem_access(mii, addr, &mii->cpu_state.data, wr, true);
-	mii->cpu_state.irq = mii->cpu_state.irq | !!mii->irq.raised;
 	return mii->cpu_state;
 }
 #endif // MII_RP2350
@@ -1313,7 +1801,7 @@ mii_run(
 	} else
 		mii->cpu.instruction_run = 100000;
 
-	mii->cpu_state = mii_cpu_run(&mii->cpu, mii->cpu_state);
+	mii->cpu_state = mii_cpu_run(&mii->cpu, mii->cpu_state, UINT64_MAX);
 
 	if (unlikely(mii->cpu_state.trap))
 		_mii_handle_trap(mii);
@@ -1335,13 +1823,9 @@ mii_read_word(
 		mii_t *mii,
 		uint16_t addr)
 {
-	uint8_t d = 0;
-	uint16_t res = 0;
-	mii_mem_access(mii, addr, &d, 0, false);
-	res = d;
-	mii_mem_access(mii, addr + 1, &d, 0, false);
-	res |= d << 8;
-	return res;
+	uint8_t d[2];
+	mii_read_range(mii, addr, d, 2);
+	return d[0] | (d[1] << 8);
 }
 /* same accessors, for write
  */
@@ -1359,10 +1843,81 @@ mii_write_word(
 		uint16_t addr,
 		uint16_t w)
 {
-	uint8_t d = w;
-	mii_mem_access(mii, addr, &d, 1, false);
-	d = w >> 8;
-	mii_mem_access(mii, addr + 1, &d, 1, false);
+	uint8_t d[2] = { w, w >> 8 };
+	mii_write_range(mii, addr, d, 2);
+}
+
+/*
+ * How many bytes from addr (up to len) can be moved in one go; that's a
+ * run of pages mapped to the same bank. $c0xx is never part of a run.
+ */
+static uint16_t
+_mii_mem_run(
+		mii_t *mii,
+		uint16_t addr,
+		uint16_t len,
+		bool write)
+{
+	uint8_t page = addr >> 8;
+	uint32_t run = 0x100 - (addr & 0xff);
+
+	if (page != 0xc0) {
+		uint8_t bank = write ? mii->mem[page].write : mii->mem[page].read;
+		for (uint32_t p = page + 1; p <= 0xff && run < len; p++) {
+			if (p == 0xc0 ||
+					bank != (write ? mii->mem[p].write : mii->mem[p].read))
+				break;
+			run += 0x100;
+		}
+	}
+	return run < len ? run : len;
+}
+
+void
+mii_read_range(
+		mii_t *mii,
+		uint16_t addr,
+		uint8_t *data,
+		uint16_t len)
+{
+	while (len) {
+		uint16_t run = _mii_mem_run(mii, addr, len, false);
+		if ((addr >> 8) == 0xc0)
+			memset(data, 0, run);
+		else
+			mii_bank_read(&mii->bank[mii->mem[addr >> 8].read],
+					addr, data, run);
+		addr += run;
+		data += run;
+		len -= run;
+	}
+}
+
+void
+mii_write_range(
+		mii_t *mii,
+		uint16_t addr,
+		const uint8_t *data,
+		uint16_t len)
+{
+	uint16_t start = addr, size = len;
+	while (len) {
+		uint16_t run = _mii_mem_run(mii, addr, len, true);
+		mii_bank_t *b = &mii->bank[mii->mem[addr >> 8].write];
+		if ((addr >> 8) == 0xc0)
+			;
+		else if (!b->ro)
+			mii_bank_write(b, addr, data, run);
+		else if (b->access) {	// ROM, only the callbacks see it
+			for (int i = 0; i < run; i++)
+				mii_bank_access(b, addr + i, data + i, 1, true);
+		}
+		addr += run;
+		data += run;
+		len -= run;
+	}
+	if (size)
+		mii_video_OOB_write_check(mii, start, size);
 }
 
 void
@@ -1413,6 +1968,77 @@ mii_cpu_next(
 	}
 }
 
+/* Recalculate the watched pages, and apply them to the current map */
+static void
+mii_debug_bp_update(
+		mii_t *mii)
+{
+#if MII_RP2350
+	memset(mii->debug.page, 0, sizeof(mii->debug.page));
+	mii->debug.pc_map = 0;
+	for (int i = 0; i < (int)sizeof(mii->debug.bp_map) * 8; i++) {
+		if (!(mii->debug.bp_map & (1 << i)))
+			continue;
+		if (mii->debug.bp[i].kind & MII_BP_PC)
+			mii->debug.pc_map |= 1 << i;
+		uint32_t first = mii->debug.bp[i].addr;
+		uint32_t last = first + mii->debug.bp[i].size - 1;
+		if (last > 0xffff)
+			last = 0xffff;
+		for (uint32_t p = first >> 8; p <= last >> 8; p++)
+			mii->debug.page[p] |= mii->debug.bp[i].kind &
+									(MII_BP_R | MII_BP_W);
+	}
+	/*
+	 * The pre-decoded ROM (and the ROM hooks in it) would let opcode and
+	 * operand fetches skip the watched pages, so it is only used when
+	 * nothing is watched.
+	 */
+	if (mii->debug.bp_map && mii->rom_decoded) {
+		mii->debug.rom_decoded = mii->rom_decoded;
+		mii->rom_decoded = NULL;
+	} else if (!mii->debug.bp_map && mii->debug.rom_decoded) {
+		mii->rom_decoded = mii->debug.rom_decoded;
+		mii->debug.rom_decoded = NULL;
+		mii_rom_hook_enable(mii, mii->rom_hook.enabled);
+	}
+	// reload the current map from the cache, without the watched pages
+	mii->page_map.key = MII_PAGE_MAP_NONE;
+	mii->mem_dirty = true;
+	mii_page_table_update(mii);
+#endif
+}
+
+int
+mii_debug_bp_set(
+		mii_t *mii,
+		uint8_t kind,
+		uint16_t addr,
+		uint8_t size)
+{
+	if (mii->debug.bp_map == (uint16_t)-1 || !size)
+		return -1;
+	int i = ffsl(~mii->debug.bp_map) - 1;
+	mii->debug.bp[i].addr = addr;
+	mii->debug.bp[i].kind = kind | MII_BP_STICKY;
+	mii->debug.bp[i].size = size;
+	mii->debug.bp[i].silent = 0;
+	mii->debug.bp_map |= 1 << i;
+	mii_debug_bp_update(mii);
+	return i;
+}
+
+void
+mii_debug_bp_clear(
+		mii_t *mii,
+		int index)
+{
+	if (index < 0 || index >= (int)sizeof(mii->debug.bp_map) * 8)
+		return;
+	mii->debug.bp_map &= ~(1 << index);
+	mii_debug_bp_update(mii);
+}
+
 #if MII_RP2350
 // Optimized run loop for RP2350 - inlines mii_run to reduce function call overhead
 void
@@ -1420,28 +2046,42 @@ mii_run_cycles(
 		mii_t *mii,
 		uint32_t cycles)
 {
-	uint64_t target_cycle = mii->cpu.total_cycle + cycles;
-	
-	while (mii->cpu.total_cycle < target_cycle && mii->state == MII_RUNNING) {
-		// Set instruction_run to approximate cycles we need (avg ~3 cycles/instruction)
-		// This limits overshoot while still batching instructions
-		uint64_t remaining = target_cycle - mii->cpu.total_cycle;
-		mii->cpu.instruction_run = (remaining < 300) ? (remaining / 3) + 1 : 100;
-		
-		mii->cpu_state = mii_cpu_run(&mii->cpu, mii->cpu_state);
-		
+	uint64_t now = mii->cpu.total_cycle + mii->cpu.cycle;
+	/*
+	 * Calls are back to back, so take off what the previous one ran past
+	 * its target (the end of its last instruction), unless something else
+	 * ran the CPU in between.
+	 */
+	uint64_t target = mii->run.target + cycles;
+	if (now < mii->run.target || now - mii->run.target > 16)
+		target = now + cycles;
+	mii->run.target = target;
+
+	while (now < target && mii->state == MII_RUNNING) {
+		// Run up to the target, or the next timer event, whichever is first
+		uint64_t deadline = mii->timer.next_event < target ?
+								mii->timer.next_event : target;
+		// one instruction (or IRQ vector) per run, checked before it runs
+		if (unlikely(mii->debug.pc_map)) {
+			if (_mii_debug_pc_check(mii, now))
+				break;
+			deadline = now + 1;
+		}
+		mii->cpu.instruction_run = UINT32_MAX;
+		mii->cpu_state = mii_cpu_run(&mii->cpu, mii->cpu_state, deadline);
+		mii->run.calls++;
+
 		if (unlikely(mii->cpu_state.trap)) {
 			_mii_handle_trap(mii);
 		}
 		
-		// Run timers periodically even without I/O access
+		// Run timers even without I/O access, as soon as one is due
 		// This is needed for VBL timing when code does tight loops without I/O
-		uint64_t total = mii->cpu.total_cycle + mii->cpu.cycle;
-		uint64_t last = mii->timer.last_run;
-		if (total > last + 1000) {  // Every ~1000 cycles
-			mii_timer_run(mii, total - last);
-			mii->timer.last_run = total;
-		}
+		now = mii->cpu.total_cycle + mii->cpu.cycle;
+		if (now >= mii->timer.next_event)
+			mii_timer_run(mii, now - mii->timer.last_run);
 	}
+	if (now > target)
+		mii->run.overshoot += now - target;
 }
 #endif
\ No newline at end of file
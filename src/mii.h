@@ -9,6 +9,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 #include "mii_65c02.h"
 #include "mii_dd.h"
@@ -47,6 +48,10 @@ enum {
 	MII_BANK_COUNT,
 };
 
+// first address, and number of entries, of mii_t.rom_decoded[]
+#define MII_ROM_DECODED_BASE	0xc100
+#define MII_ROM_DECODED_SIZE	(0x10000 - MII_ROM_DECODED_BASE)
+
 /*
  * A 'trap' is a sequence of 2 special NOPs that are used to trigger
  * a callback. The callback is called with the mii_t * and the trap ID,
@@ -64,6 +69,28 @@ typedef struct mii_trap_t {
 	}		trap[16];
 } mii_trap_t;
 
+/*
+ * A ROM hook is a native version of a ROM routine, called in place of the
+ * instruction at 'addr' when that address is mapped to the ROM (so never
+ * for RAM or card ROM shadowing it). The callback either does the whole
+ * routine, RTS included, with the same registers, flags and memory writes,
+ * and returns the cycles the ROM code takes; or it returns 0 without
+ * changing anything, and the ROM code runs. It can't take more than
+ * 'budget' cycles, a timer or the end of the run is due after that.
+ */
+typedef uint32_t (*mii_rom_hook_cb)(
+				struct mii_t * mii,
+				uint32_t budget);
+typedef struct mii_rom_hook_t {
+	uint16_t		addr;
+	const char *	name;
+	mii_rom_hook_cb	cb;
+	uint32_t		calls;		// routine done natively
+	uint32_t		cycles;		// ... emulated cycles it took
+} mii_rom_hook_t;
+// mii_cpu_decoded_t.hook has 4 bits, 0 is 'none'
+#define MII_ROM_HOOK_COUNT	15
+
 // state of the emulator
 enum {
 	MII_INIT = 0,
@@ -95,6 +122,8 @@ typedef struct mii_trace_t {
 	uint32_t 	step_inst;
 } mii_trace_t;
 
+#define MII_TIMER_NONE	0xff
+
 typedef uint64_t (*mii_timer_p)(
 				struct mii_t * mii,
 				void * param );
@@ -103,17 +132,147 @@ typedef uint64_t (*mii_timer_p)(
 #define MII_SPEED_PAL 	1.0178571429	// 14.25 MHz / 14
 #define MII_SPEED_TITAN 3.58
 
+/*
+ * Handlers for one address of the $C000-$C0FF I/O page. 'read' gets the
+ * byte currently on the bus, and returns the one read.
+ */
+typedef uint8_t (*mii_io_read_p)(
+				struct mii_t * mii,
+				void * param,
+				uint16_t addr,
+				uint8_t byte);
+typedef void (*mii_io_write_p)(
+				struct mii_t * mii,
+				void * param,
+				uint16_t addr,
+				uint8_t byte);
+
+enum {
+	MII_IO_OVERRIDE	= (1 << 0),	// replaced by mii_set_sw_override()
+};
+
+typedef struct mii_io_t {
+	mii_io_read_p	read;
+	mii_io_write_p	write;
+	void *			read_param;
+	void *			write_param;
+	uint8_t			flags;		// MII_IO_*
+} mii_io_t;
+
+/*
+ * Number of page maps kept by mii_page_table_update(), one per combination
+ * of the memory management soft switches seen recently.
+ */
+#ifndef MII_PAGE_MAP_COUNT
+#define MII_PAGE_MAP_COUNT	4
+#endif
+#define MII_PAGE_MAP_NONE	0xffffffff
+
+#if MII_RP2350
+/*
+ * Number of 64KB RAMWorks III banks, including the standard aux bank 0.
+ * Bank 0 stays in SRAM (video reads it), the others live in PSRAM and
+ * are mapped straight into the page table; 1 disables the card.
+ */
+#ifndef MII_RAMWORKS_BANKS
+#define MII_RAMWORKS_BANKS	16
+#endif
+#endif
+
+/* A copy of mii_t's mem[], mem_read[], mem_write[] and mem_write_gen[] */
+typedef struct mii_page_map_t {
+	uint32_t		key;	// soft switches it was built for
+	uint32_t		used;	// LRU stamp
+	uint8_t			mem[256];
+	uint8_t *		read[256];
+	uint8_t *		write[256];
+	uint32_t *		write_gen[256];
+} mii_page_map_t;
+
 /*
  * principal emulator state, for a faceless emulation
  */
 typedef struct mii_t {
+	/*
+	 * Everything mii_cpu_run() touches for each instruction comes first,
+	 * up to the running timer list, in the first 4KB of mii_t (checked
+	 * below on ARM). The bulky and rarely used state follows.
+	 */
+	mii_cpu_t 		cpu __attribute__((aligned(32)));
+	mii_cpu_state_t	cpu_state;
+	unsigned int	state;
+	/*
+	 * These are the 'real' state of the soft switches, as opposed to the
+	 * value stores in the C000 page. This is made so they can be easily
+	 * manipulated, copied, and restored... use the macros in mii_sw.h
+	 */
+	uint32_t 		sw_state;	// B_SW* bitfield
+	/*
+	 * bank index for each memory page number, this is recalculated
+	 * everytime a MMU soft switch is triggered
+	 */
+	struct  		{
+		union {
+			struct {
+				uint8_t write : 4, read : 4;
+			};
+			uint8_t 	both;
+		};
+	} 				mem[256];
+	/*
+	 * Host pointers for each page, matching mem[] above, with the bank base
+	 * and offset already applied; so mem_read[addr >> 8][addr & 0xff] is
+	 * the byte. Pages from read only banks have their write pointer set to
+	 * a discard page, so the CPU fast path never has to check.
+	 */
+	uint8_t *		mem_read[256];
+	uint8_t *		mem_write[256];
+	// write generation counter for each page, see mii_bank_t.gen
+	uint32_t *		mem_write_gen[256];
+	/*
+	 * Pre-decoded instructions for the ROM bank, from $c100 up. Set by
+	 * whoever loads the ROM, optional. See mii_cpu_decode()
+	 */
+	mii_cpu_decoded_t * rom_decoded;
+	int 			mem_dirty;	// recalculate mem[] on next access
+	mii_bank_t		bank[MII_BANK_COUNT];
+	/*
+	 * These are 'cycle timers' -- they count down from a set value,
+	 * and stop at 0 (or possibly -1 or -2, depending on the instructions)
+	 * and call the callback (if present).
+	 * The callback returns the number of cycles to wait until the next
+	 * call.
+	 * Running timers are kept in a list sorted by their absolute deadline
+	 * (in total_cycle), so the CPU only has to compare against next_event
+	 * to know whether anything is due.
+	 */
+	struct {
+		uint64_t 	map;
+		uint64_t	last_run;	// last total_cycle when timer_run was called
+		uint64_t	next_event;	// deadline of 'head', or UINT64_MAX
+		uint8_t		head;		// first running timer, MII_TIMER_NONE if none
+		// not looked at by the CPU, only when a timer is due
+		struct mii_timer_t {
+			mii_timer_p 		cb;
+			void *				param;
+			uint64_t			deadline;	// when running
+			int64_t 			when;		// cycles left, when stopped
+			uint8_t				next;		// next running timer
+			uint8_t				running;
+			const char *		name; // debug
+		} timers[64];
+	}				timer;
+
 	// this is the 'emulation' type, IIEE or IIC [currently only IIe works]
 	uint 			emu; // MII_EMU_*
-	mii_cpu_t 		cpu;
-	mii_cpu_state_t	cpu_state;
+	/* mii_run_cycles() bookkeeping, and counters for the perf metrics */
+	struct {
+		uint64_t		target;		// total_cycle the last call aimed for
+		uint32_t		calls;		// mii_cpu_run() calls
+		uint32_t		overshoot;	// cycles run past the targets
+	}				run;
 	/* this is the CPU speed, default to MII_SPEED_NTSC */
 	float			speed;
-	unsigned int	state;
 	/*
 	 * These are used as MUX for IRQ requests from drivers. Each driver
 	 * can request an IRQ number, and 'raise' and 'clear' it, and the
@@ -123,47 +282,34 @@ typedef struct mii_t {
 	 * This fixes the problem of multiple drivers trying to raise the
 	 * only IRQ line on the CPU. Typically if you have the mouse card and
 	 * the serial card, or the mockingboard.
+	 * The raised ones are the bits of cpu.irq_pending, that the CPU checks
+	 * between instructions.
 	 */
 	struct {
 		uint16_t 		map;
-		uint16_t 		raised;
-		struct {
+		struct mii_irq_t {
 			const char * name;
 			uint8_t 	count;
+			uint64_t	raised;		// total_cycle when it was raised
+			// raises that got the CPU to the IRQ vector, and the cycles
+			// that took, for the perf metrics
+			uint32_t	taken;
+			uint32_t	latency;
+			uint32_t	latency_max;
 		}			irq[16];
 	}				irq;
 	/*
-	 * These are 'cycle timers' -- they count down from a set value,
-	 * and stop at 0 (or possibly -1 or -2, depending on the instructions)
-	 * and call the callback (if present).
-	 * The callback returns the number of cycles to wait until the next
-	 * call.
+	 * Page maps already built, keyed by the soft switches that matter;
+	 * switching back to one of them is a copy, not a rebuild. They are
+	 * flushed when the host memory behind a bank changes.
 	 */
 	struct {
-		uint64_t 	map;
-#if MII_65C02_DIRECT_ACCESS
-		uint64_t	last_run;	// last total_cycle when timer_run was called
-#endif
-		struct {
-			mii_timer_p 		cb;
-			void *				param;
-			int64_t 			when;
-			const char *		name; // debug
-		} timers[64];
-	}				timer;
-	/*
-	 * bank index for each memory page number, this is recalculated
-	 * everytime a MMU soft switch is triggered
-	 */
-	struct  		{
-		union {
-			struct {
-				uint8_t write : 4, read : 4;
-			};
-			uint8_t 	both;
-		};
-	} 				mem[256];
-	int 			mem_dirty;	// recalculate mem[] on next access
+		uint32_t		key;		// of the current map
+		uint32_t		stamp;		// LRU clock
+		uint32_t		hit;		// maps found in the cache
+		uint32_t		rebuild;	// maps built from scratch
+		mii_page_map_t	map[MII_PAGE_MAP_COUNT];
+	}				page_map;
 	/*
 	 * RAMWORKS card emulation, this is a 16MB address space, with 128
 	 * possible 64KB banks. The 'avail' bitfield marks the banks that
@@ -174,24 +320,24 @@ typedef struct mii_t {
 	 */
 	struct {
 #if MII_RP2350
-		uint32_t			avail_lo;
-		uint32_t			avail_hi;
-		uint32_t			avail_lo2;
-		uint32_t			avail_hi2;
+		uint32_t			avail[4];
+		uint32_t			switches;	// bank register writes that changed bank
+		uint32_t			us;			// total time spent switching
+		uint32_t			us_max;		// slowest switch
 #else
 		unsigned __int128	avail;
 #endif
+		uint8_t				current;	// bank mapped in MII_BANK_AUX
 		uint8_t * 			bank[128];
 	}				ramworks;
-	/*
-	 * These are the 'real' state of the soft switches, as opposed to the
-	 * value stores in the C000 page. This is made so they can be easily
-	 * manipulated, copied, and restored... use the macros in mii_sw.h
-	 */
-	uint32_t 		sw_state;	// B_SW* bitfield
 	mii_trace_t		trace;
 	int				trace_cpu;
 	mii_trap_t		trap;
+	struct {
+		bool			enabled;
+		uint8_t			count;
+		mii_rom_hook_t	hook[MII_ROM_HOOK_COUNT];
+	}				rom_hook;
 	mii_signal_pool_t sig_pool;	// vcd support
 	/*
 	 * Used for debugging only
@@ -204,14 +350,29 @@ typedef struct mii_t {
 							size : 8,
 							silent : 1;
 		}			bp[16];
+#if MII_RP2350
+		/*
+		 * MII_BP_R/W kinds set on each page; these pages have no host
+		 * pointer in mem_read[]/mem_write[], so only their accesses leave
+		 * the CPU fast path. The pre-decoded ROM is put aside meanwhile.
+		 * MII_BP_PC breakpoints (pc_map) are checked before each
+		 * instruction instead, the CPU runs one at a time while any is set.
+		 */
+		uint8_t			page[256];
+		uint16_t		pc_map;
+		uint64_t		pc_stop;	// cycle stopped at, to resume from it
+		mii_cpu_decoded_t * rom_decoded;
+		mii_cpu_state_t	hit;		// access that stopped the CPU
+#endif
 	}				debug;
-	mii_bank_t		bank[MII_BANK_COUNT];
 	/*
-	 * The page c000 can have individual callbacks to override/supplement
-	 * existing default behaviour. This is currently used for the titan
-	 * accelerator 'card'
+	 * Handlers for each address of the c000 page, so an I/O access is a
+	 * single indirect call. Slot drivers fill their own $c0n0-$c0nf, and
+	 * mii_set_sw_override() replaces entries (titan accelerator 'card').
+	 * io_count is a histogram of the accesses, for the perf metrics.
 	 */
-	mii_bank_access_t * soft_switches_override;
+	mii_io_t		io[256];
+	uint32_t		io_count[256];
 	mii_slot_t		slot[7];
 
 	/*
@@ -226,6 +387,11 @@ typedef struct mii_t {
 	mii_audio_sink_t audio;
 } mii_t;
 
+#if MII_RP2350 && defined(__arm__)
+// see the layout of mii_t, above
+_Static_assert(offsetof(mii_t, timer.timers) < 4096, "mii_t hot block too big");
+#endif
+
 enum {
 	MII_INIT_NSC 			= (1 << 0), // Install no slot clock
 	MII_INIT_TITAN			= (1 << 1), // Install Titan 'card'
@@ -342,6 +508,25 @@ mii_write_word(
 		mii_t *mii,
 		uint16_t addr,
 		uint16_t w);
+/*
+ * Move a range of bytes as the processor would, without its side effects:
+ * $c0xx reads as zero and ignores writes, $cfff reads the mapped byte and
+ * leaves the slot expansion ROMs selected. Runs of pages mapped to the same bank are
+ * copied in one go, only pages with an access callback go byte by byte.
+ * Writes notify the video once for the whole range.
+ */
+void
+mii_read_range(
+		mii_t *mii,
+		uint16_t addr,
+		uint8_t *data,
+		uint16_t len);
+void
+mii_write_range(
+		mii_t *mii,
+		uint16_t addr,
+		const uint8_t *data,
+		uint16_t len);
 /* lower level call to access memory -- this one can trigger softswitches
  * if specified. Otherwise behaves as the previous ones, one byte at a time
  */
@@ -352,15 +537,22 @@ mii_mem_access(
 		uint8_t * byte,
 		bool write,
 		bool do_sw);
-/* register a callback to call when a specific soft switches is hit,
- * this allows overriding/supplementing/tracing access to sw.
+/* replace the handlers for soft switch sw_addr; a NULL read or write
+ * keeps the current one, with its own param. This allows
+ * overriding/tracing access to sw.
  */
 void
 mii_set_sw_override(
 		mii_t *mii,
 		uint16_t sw_addr,
-		mii_bank_access_cb cb,
+		mii_io_read_p read,
+		mii_io_write_p write,
 		void *param);
+/* point the I/O handlers of the slot's $c0n0-$c0nf to its driver */
+void
+mii_io_slot_attach(
+		mii_t *mii,
+		mii_slot_t *slot);
 
 /* register a cycle timer. cb will be called when (at least) when
  * cycles have been spent -- the callback returns how many it should
@@ -382,6 +574,11 @@ mii_timer_set(
 		mii_t *mii,
 		uint8_t timer_id,
 		int64_t when);
+/* advance timers by 'cycles' since last_run, calling the ones due */
+void
+mii_timer_run(
+		mii_t *mii,
+		uint64_t cycles);
 
 uint8_t
 mii_irq_register(
@@ -427,6 +624,29 @@ mii_register_trap(
 		mii_t *mii,
 		mii_trap_handler_cb cb);
 
+/*
+ * Add a native version of the ROM routine at 'addr', see mii_rom_hook_cb.
+ * Returns its index in mii->rom_hook, or -1 if there is no room.
+ */
+int
+mii_rom_hook_register(
+		mii_t *mii,
+		uint16_t addr,
+		const char *name,
+		mii_rom_hook_cb cb);
+/*
+ * Turn the ROM hooks on or off, at any time (to compare with the ROM
+ * code). Also needs calling when mii->rom_decoded is (re)built.
+ */
+void
+mii_rom_hook_enable(
+		mii_t *mii,
+		bool enable);
+/* Register the Monitor routines we have native versions of, if the ROM has them */
+void
+mii_rom_hook_install(
+		mii_t *mii);
+
 /*
  * this is used if libmish is active, to register the 'mii' commands
  */
@@ -443,6 +663,22 @@ mii_cpu_step(
 void
 mii_cpu_next(
 		mii_t *mii);
+/*
+ * Add a sticky breakpoint (MII_BP_PC) or watchpoint (MII_BP_R/W) on
+ * 'size' bytes from 'addr'; the CPU stops (MII_STOPPED) before the
+ * instruction at a breakpoint runs, after the one that hits a watchpoint.
+ * Returns its index, or -1 if none are left.
+ */
+int
+mii_debug_bp_set(
+		mii_t *mii,
+		uint8_t kind,
+		uint16_t addr,
+		uint8_t size);
+void
+mii_debug_bp_clear(
+		mii_t *mii,
+		int index);
 #if MII_RP2350
 void
 mii_run_cycles(
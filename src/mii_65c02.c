@@ -10,7 +10,6 @@
 #include <stdio.h>
 #include <stdlib.h>
 
-#include "minipt.h"
 #include "mii_65c02.h"
 #include "debug_log.h"
 #define MII_CPU_65C02_IMPL
@@ -27,52 +26,328 @@ mii_cpu_init(
 		.addr = 0,
 		.reset = 1,
 	};
-#if MII_65C02_DIRECT_ACCESS
-#else
-	cpu->state = NULL;
-#endif
 	return s;
 }
 
-#if MII_65C02_DIRECT_ACCESS
+void
+mii_cpu_decode(
+		const uint8_t *mem,
+		uint32_t count,
+		mii_cpu_decoded_t *out )
+{
+	for (uint32_t i = 0; i < count; i++) {
+		out[i].ir = mem[i];
+		out[i].hook = 0;
+		out[i].operand = (i + 1 < count ? mem[i + 1] : 0) |
+						((i + 2 < count ? mem[i + 2] : 0) << 8);
+	}
+}
+
+#if MII_65C02_BCD_TABLES
+/*
+ * Decimal ADC in two steps of one digit each. _mii_bcd_lo[] is indexed by
+ * the low nibbles of A and the operand plus C, and gives the low digit with
+ * the carry into the high one in bit 4. _mii_bcd_hi[] is indexed the same
+ * way by the high nibbles plus that carry, and gives the high digit in the
+ * top nibble, C in bit 0 and V in bit 1. The entries are the nibble
+ * arithmetic of the !MII_65C02_BCD_TABLES code, evaluated by the compiler;
+ * they are not const so they live in SRAM.
+ */
+#define _BCD_A(i)		((i) >> 5)
+#define _BCD_D(i)		(((i) >> 1) & 0xf)
+#define _BCD_SUM(i)		(_BCD_A(i) + _BCD_D(i) + ((i) & 1))
+#define _BCD_ADJ(i)		(_BCD_SUM(i) > 9 ? _BCD_SUM(i) + 6 : _BCD_SUM(i))
+#define _BCD_LO(i)		((_BCD_ADJ(i) & 0xf) | ((_BCD_ADJ(i) > 0xf) << 4)),
+#define _BCD_HI(i)		(((_BCD_ADJ(i) & 0xf) << 4) | (_BCD_ADJ(i) > 0xf) | \
+		((!((_BCD_A(i) ^ _BCD_D(i)) & 8) && ((_BCD_A(i) ^ _BCD_SUM(i)) & 8)) << 1)),
+#define _BCD_R4(m, i)	m(i) m((i) + 1) m((i) + 2) m((i) + 3)
+#define _BCD_R16(m, i)	_BCD_R4(m, i) _BCD_R4(m, (i) + 4) \
+		_BCD_R4(m, (i) + 8) _BCD_R4(m, (i) + 12)
+#define _BCD_R64(m, i)	_BCD_R16(m, i) _BCD_R16(m, (i) + 16) \
+		_BCD_R16(m, (i) + 32) _BCD_R16(m, (i) + 48)
+#define _BCD_R512(m)	_BCD_R64(m, 0) _BCD_R64(m, 64) _BCD_R64(m, 128) \
+		_BCD_R64(m, 192) _BCD_R64(m, 256) _BCD_R64(m, 320) \
+		_BCD_R64(m, 384) _BCD_R64(m, 448)
+
+static uint8_t _mii_bcd_lo[512] = { _BCD_R512(_BCD_LO) };
+static uint8_t _mii_bcd_hi[512] = { _BCD_R512(_BCD_HI) };
+
+/* A + d + C in decimal, sets C and V, returns the new A */
+static inline uint8_t __attribute__((always_inline))
+_mii_cpu_bcd_add(
+		mii_cpu_t *cpu,
+		uint8_t a,
+		uint8_t d )
+{
+	uint8_t lo = _mii_bcd_lo[((a & 0xf) << 5) | ((d & 0xf) << 1) | !!cpu->P.C];
+	uint8_t hi = _mii_bcd_hi[((a >> 4) << 5) | ((d >> 4) << 1) | (lo >> 4)];
+	cpu->P.C = hi & 1;
+	cpu->P.V = (hi >> 1) & 1;
+	return (hi & 0xf0) | (lo & 0x0f);
+}
+#endif
+
+#if !MII_65C02_DIRECT_ACCESS
+#error "MII_65C02_DIRECT_ACCESS *has* to be enabled here"
+#endif
+
+/*
+ * A raised IRQ source only matters once I is clear; until then the core
+ * keeps to its fast path. Tested after every instruction, so CLI, PLP and
+ * RTI are seen at the next boundary.
+ */
+#define _IRQ_TAKEN(_cpu) ((_cpu)->irq_pending && !(_cpu)->P.I)
 
 #if MII_RP2350
 /*
  * Ultra-fast inline memory access for RP2350.
  * Avoids function pointer overhead by inlining the memory access directly.
  * 
- * Fast path: addresses outside $C000-$C0FF (RAM, stack, ROM, etc.)
- * Slow path: only $C000-$C0FF (I/O soft switches)
+ * Fast path: pages with a host pointer in mii->mem_read[]/mem_write[]
+ * Slow path: pages without one; $C000-$C0FF (I/O soft switches), and
+ * pages with a watchpoint or breakpoint (see mii_debug_bp_set())
  * 
  * Performance optimizations:
  * 1. Timer runs only on I/O access (disk LSS only needs timing when accessing $C0Ex)
  * 2. Cache mii pointer at start of instruction batch
  * 3. Use __builtin_expect for branch prediction
- * 4. Minimize memory indirection in fast path
+ * 4. Minimize memory indirection in fast path: mii->mem_read[] and
+ *    mii->mem_write[] hold ready to use host pointers for each page
  */
 #include "mii.h"
 
-/* Forward declare timer run */
-extern void mii_timer_run(mii_t *mii, uint64_t cycles);
-
-/* Check if address is in I/O range ($C000-$C0FF) */
-#define _IS_IO_ADDR(_a) (((_a) & 0xFF00) == 0xC000)
-
 /* 
  * Run timers - only called on I/O access now.
  * Disk II LSS timing only matters when we're accessing $C0Ex.
  * VBL timer is coarse enough that batching is fine.
+ * Only the earliest deadline is checked; otherwise just move last_run so
+ * mii_timer_get() stays exact for the device being accessed.
  */
 static inline void __attribute__((always_inline))
 _run_timers_inline(mii_cpu_t *cpu) {
 	mii_t *_mii = cpu->access_param;
 	uint64_t _total = cpu->total_cycle + cpu->cycle;
-	uint64_t _last = _mii->timer.last_run;
-	if (_total > _last) {
-		mii_timer_run(_mii, _total - _last);
+	if (unlikely(_total >= _mii->timer.next_event))
+		mii_timer_run(_mii, _total - _mii->timer.last_run);
+	else
 		_mii->timer.last_run = _total;
+}
+
+/*
+ * Slow path for the I/O page, kept out of line so the (many, with the
+ * threaded core) inlined copies of _FETCH/_STORE stay small.
+ */
+static mii_cpu_state_t __attribute__((noinline))
+_mii_cpu_io_access(
+		mii_cpu_t *cpu,
+		mii_cpu_state_t s)
+{
+	_run_timers_inline(cpu);
+	return cpu->access(cpu, s);
+}
+
+/*
+ * With MII_65C02_LOCAL_REGS, mii_cpu_run() works on a local copy of the
+ * CPU, so the compiler can keep the registers, cycle counters and
+ * access_param in host registers for the whole run (stores to guest memory
+ * can't alias a local whose address is never taken). Anything else only
+ * ever looks at mii->cpu, so the copy is written back before calling out
+ * (I/O, traps, returning) and reloaded after, as the callee might have
+ * changed instruction_run, cycle_limit etc.
+ */
+#if MII_65C02_LOCAL_REGS
+#define _CPU_REAL() \
+		(&((mii_t*)cpu->access_param)->cpu)
+#define _CPU_SAVE() \
+		*_CPU_REAL() = *cpu
+#define _CPU_LOAD() \
+		*cpu = *_CPU_REAL()
+#else
+#define _CPU_REAL() cpu
+#define _CPU_SAVE()
+#define _CPU_LOAD()
+#endif
+
+static inline mii_cpu_state_t __attribute__((always_inline))
+_mii_cpu_io(
+		mii_cpu_t *cpu,
+		mii_cpu_state_t s)
+{
+	_CPU_SAVE();
+	s = _mii_cpu_io_access(_CPU_REAL(), s);
+	_CPU_LOAD();
+	return s;
+}
+
+#if MII_65C02_IDLE_SKIP
+mii_cpu_idle_stats_t mii_cpu_idle_stats;
+
+/*
+ * Called when a branch is about to jump back to the instruction just
+ * before it; if that was a load from an I/O location that only changes
+ * on a timer (or between frames, for the keyboard), every iteration until
+ * the next timer deadline reads the same value, so skip them all.
+ */
+static void __attribute__((noinline))
+_mii_cpu_idle_skip(
+		mii_cpu_t *cpu,
+		mii_cpu_state_t s)
+{
+	mii_t *_mii = cpu->access_param;
+	const uint16_t pc = cpu->cpu_P;
+	const uint8_t ir = (cpu->ir_log >> 8) & 0xff;
+
+	if (s.reset || s.irq || s.nmi || cpu->IRQ || _IRQ_TAKEN(cpu))
+		return;
+	// the load must have happened in this run, the key might have changed
+	if (cpu->total_cycle <= cpu->run_start + 1)
+		return;
+	// LDA, LDX, LDY or BIT absolute
+	if (ir != 0xad && ir != 0xae && ir != 0xac && ir != 0x2c)
+		return;
+	const uint8_t *m = _mii->mem_read[pc >> 8];
+	if (!m || (pc & 0xff) > 0xfd || m[pc & 0xff] != ir || m[(pc & 0xff) + 2] != 0xc0)
+		return;
+	const uint8_t sw = m[(pc & 0xff) + 1];
+	// keyboard & status reads, buttons and paddles; not $C010 (strobe)
+	if (!((sw <= 0x1f && sw != 0x10) || (sw >= 0x61 && sw <= 0x67)))
+		return;
+	if (_mii->io[sw].flags & MII_IO_OVERRIDE)
+		return;
+	/*
+	 * The load takes 4 cycles and reads on the last one, the branch took
+	 * 1 + cpu->cycle so far. All the skipped reads must happen before the
+	 * next timer is due, and we can't run more instructions than asked,
+	 * or past cycle_limit.
+	 */
+	const uint64_t now = cpu->total_cycle + cpu->cycle;
+	const uint32_t iter = 4 + 1 + cpu->cycle;
+	if (_mii->timer.next_event <= now + 4 || cpu->cycle_limit <= now + 1)
+		return;
+	uint64_t count = (_mii->timer.next_event - now - 5) / iter + 1;
+	if (count > cpu->instruction_run / 2)
+		count = cpu->instruction_run / 2;
+	if (count > (cpu->cycle_limit - now - 1) / iter)
+		count = (cpu->cycle_limit - now - 1) / iter;
+	if (!count)
+		return;
+	cpu->total_cycle += count * iter;
+	cpu->instruction_run -= count * 2;
+	_mii->timer.last_run = now + 4 + (count - 1) * iter;
+	mii_cpu_idle_stats.loops++;
+	mii_cpu_idle_stats.cycles += count * iter;
+}
+#endif
+
+#if MII_65C02_LOOP_SKIP
+mii_cpu_loop_stats_t mii_cpu_loop_stats;
+
+/*
+ * Called when a BNE is about to jump back to the instruction just before
+ * it; if that only counts a register down (or up) by one, the loop has no
+ * bus side effect, so run all the iterations but the last in one go. The
+ * last one is left to the core, it falls through the BNE.
+ */
+static void __attribute__((noinline))
+_mii_cpu_loop_skip(
+		mii_cpu_t *cpu,
+		mii_cpu_state_t s)
+{
+	mii_t *_mii = cpu->access_param;
+	const uint16_t pc = cpu->cpu_P;
+	const uint8_t ir = (cpu->ir_log >> 8) & 0xff;
+	uint8_t *reg = NULL;
+	int up = 0;
+
+	if (s.reset || s.irq || s.nmi || cpu->IRQ || _IRQ_TAKEN(cpu))
+		return;
+	if (pc == (uint16_t)(cpu->PC - 3)) {
+		switch (ir) {
+			case 0xca: reg = &cpu->X; break;			// DEX
+			case 0x88: reg = &cpu->Y; break;			// DEY
+			case 0x3a: reg = &cpu->A; break;			// DEC
+			case 0xe8: reg = &cpu->X; up = 1; break;	// INX
+			case 0xc8: reg = &cpu->Y; up = 1; break;	// INY
+			case 0x1a: reg = &cpu->A; up = 1; break;	// INC
+		}
+	} else if (ir == 0xe9 && pc == (uint16_t)(cpu->PC - 4) &&
+				!cpu->P.D && cpu->P.C) {	// SBC #1
+		// with carry set, and no borrow, it's the same as DEC
+		const uint8_t *m = _mii->mem_read[pc >> 8];
+		if (m && (pc & 0xff) != 0xff && m[(pc & 0xff) + 1] == 0x01)
+			reg = &cpu->A;
 	}
+	if (!reg)
+		return;
+	/*
+	 * The register isn't zero, or we wouldn't branch; that many iterations
+	 * remain, the last one doesn't branch. Each takes 2 cycles, plus
+	 * 1 + cpu->cycle for the branch (page crossing included). They have to
+	 * end before the next timer and cycle_limit, and we can't run more
+	 * instructions than asked.
+	 */
+	uint64_t count = up ? 0xff - *reg : *reg - 1;
+	const uint64_t now = cpu->total_cycle + cpu->cycle;
+	const uint32_t iter = 2 + 1 + cpu->cycle;
+	uint64_t limit = cpu->cycle_limit;
+	if (_mii->timer.next_event < limit)
+		limit = _mii->timer.next_event;
+	if (limit <= now + 1)
+		return;
+	if (count > (limit - now - 1) / iter)
+		count = (limit - now - 1) / iter;
+	if (count > cpu->instruction_run / 2)
+		count = cpu->instruction_run / 2;
+	if (!count)
+		return;
+	*reg = up ? *reg + count : *reg - count;
+	cpu->P.N = !!(*reg & 0x80);
+	if (ir == 0xe9)	// only the $80 - 1 one overflows
+		cpu->P.V = *reg == 0x7f;
+	cpu->total_cycle += count * iter;
+	cpu->instruction_run -= count * 2;
+	mii_cpu_loop_stats.loops++;
+	mii_cpu_loop_stats.cycles += count * iter;
 }
+#endif
+
+#if MII_65C02_ROM_HOOKS
+/*
+ * The opcode just fetched from the ROM has a native version of its
+ * routine; give it a go if nothing is pending, and if there are cycles
+ * left before the next timer and the end of the run. Returns true if the
+ * routine was done, and its cycles (less the opcode fetch, that was
+ * already counted) added to total_cycle.
+ */
+static bool __attribute__((noinline))
+_mii_cpu_rom_hook(
+		mii_cpu_t *cpu,
+		mii_cpu_state_t s,
+		uint8_t hook)
+{
+	mii_t *_mii = cpu->access_param;
+	mii_rom_hook_t *h = &_mii->rom_hook.hook[hook - 1];
+
+	if (s.reset || s.irq || s.nmi || cpu->IRQ || _IRQ_TAKEN(cpu) ||
+			cpu->P.D || !cpu->instruction_run)
+		return false;
+	const uint64_t now = cpu->total_cycle;
+	uint64_t limit = cpu->cycle_limit;
+	if (_mii->timer.next_event < limit)
+		limit = _mii->timer.next_event;
+	if (limit <= now + 1)
+		return false;
+	uint64_t budget = limit - now - 1;
+	uint32_t cycles = h->cb(_mii, budget > UINT32_MAX ? UINT32_MAX : budget);
+	if (!cycles)
+		return false;
+	cpu->total_cycle += cycles - 1;
+	cpu->instruction_run--;
+	h->calls++;
+	h->cycles += cycles;
+	return true;
+}
+#endif
 
 /*
  * Optimized FETCH macro for RP2350:
@@ -83,18 +358,22 @@ _run_timers_inline(mii_cpu_t *cpu) {
 #define _FETCH(_val) { \
 		s.addr = (_val); s.w = 0; cpu->cycle++; \
 		uint16_t _a = s.addr; \
-		if (likely(!_IS_IO_ADDR(_a))) { \
-			mii_t *_mii = cpu->access_param; \
-			uint8_t _page = _a >> 8; \
-			uint8_t _m = _mii->mem[_page].read; \
-			mii_bank_t *_b = &_mii->bank[_m]; \
-			s.data = _b->mem[_b->mem_offset + _a - _b->base]; \
+		mii_t *_mii = cpu->access_param; \
+		const uint8_t *_p = _mii->mem_read[_a >> 8]; \
+		if (likely(_p)) { \
+			s.data = _p[_a & 0xff]; \
 		} else { \
-			_run_timers_inline(cpu); \
-			s = cpu->access(cpu, s); \
+			s = _mii_cpu_io(cpu, s); \
 		} \
 	}
 
+/* page write generations, for the video etc */
+#if MII_65C02_WRITE_GEN
+#define _STORE_GEN(_mii, _a) (*(_mii)->mem_write_gen[(_a) >> 8])++
+#else
+#define _STORE_GEN(_mii, _a)
+#endif
+
 /*
  * Optimized STORE macro for RP2350:
  * - Same optimizations as FETCH
@@ -102,17 +381,36 @@ _run_timers_inline(mii_cpu_t *cpu) {
 #define _STORE(_addr, _val) { \
 		s.addr = (_addr); s.data = (_val); s.w = 1; cpu->cycle++; \
 		uint16_t _a = s.addr; \
-		if (likely(!_IS_IO_ADDR(_a))) { \
-			mii_t *_mii = cpu->access_param; \
-			uint8_t _page = _a >> 8; \
-			uint8_t _m = _mii->mem[_page].write; \
-			mii_bank_t *_b = &_mii->bank[_m]; \
-			_b->mem[_b->mem_offset + _a - _b->base] = s.data; \
+		mii_t *_mii = cpu->access_param; \
+		uint8_t *_p = _mii->mem_write[_a >> 8]; \
+		if (likely(_p)) { \
+			_p[_a & 0xff] = s.data; \
+			_STORE_GEN(_mii, _a); \
 		} else { \
-			_run_timers_inline(cpu); \
-			s = cpu->access(cpu, s); \
+			s = _mii_cpu_io(cpu, s); \
 		} \
 	}
+
+/*
+ * Pre-decoded ROM instructions, only valid if the opcode *and* the two
+ * following bytes are in pages currently mapped to the ROM bank; otherwise
+ * INTCXROM/SLOTC3ROM/BSR have RAM or card ROM there, and we decode as usual.
+ */
+static inline const mii_cpu_decoded_t * __attribute__((always_inline))
+_mii_cpu_decoded(
+		mii_cpu_t *cpu,
+		uint16_t pc)
+{
+	mii_t *_mii = cpu->access_param;
+	uint8_t page = pc >> 8;
+	if (!_mii->rom_decoded || _mii->mem[page].read != MII_BANK_ROM)
+		return NULL;
+	if ((pc & 0xff) >= 0xfe &&
+			_mii->mem[(uint8_t)(page + 1)].read != MII_BANK_ROM)
+		return NULL;
+	return &_mii->rom_decoded[pc - MII_ROM_DECODED_BASE];
+}
+#define _DECODED(_pc) _mii_cpu_decoded(cpu, _pc)
 #else
 /* Original callback-based access for desktop */
 #define _FETCH(_val) { \
@@ -123,18 +421,23 @@ _run_timers_inline(mii_cpu_t *cpu) {
 		s.addr = _addr; s.data = _val; s.w = 1; cpu->cycle++; \
 		s = cpu->access(cpu, s); \
 	}
+#define _DECODED(_pc) NULL
+#define _CPU_SAVE()
+#define _CPU_LOAD()
 #endif
 
-#else
-#define _FETCH(_val) { \
-		s.addr = _val; s.w = 0; cpu->cycle++; \
-		pt_yield(cpu->state); \
-	}
-#define _STORE(_addr, _val) { \
-		s.addr = _addr; s.data = _val; s.w = 1; cpu->cycle++; \
-		pt_yield(cpu->state); \
+/*
+ * Fetch the next byte of the instruction stream; from the pre-decoded
+ * operand if there is one, it's the same cycle either way.
+ */
+#define _FETCH_OPERAND() { \
+		if (dc) { \
+			s.addr = cpu->PC++; s.w = 0; cpu->cycle++; \
+			s.data = operand; \
+			operand >>= 8; \
+		} else \
+			_FETCH(cpu->PC++); \
 	}
-#endif
 
 #define _NZC(_val) { \
 		uint16_t v = (_val); \
@@ -151,101 +454,49 @@ _run_timers_inline(mii_cpu_t *cpu) {
 		cpu->P.C = !!(_val); \
 	}
 
-mii_cpu_state_t
-mii_cpu_run(
+/*
+ * Executes one instruction, once the opcode has been fetched into cpu->IR.
+ * 'dc' is the pre-decoded instruction, if the opcode came from the ROM.
+ * This is always inlined; when 'ir' is a constant (threaded dispatch) the
+ * compiler folds the descriptor and both switches away, leaving only the
+ * code for that opcode.
+ */
+static inline mii_cpu_state_t __attribute__((always_inline))
+_mii_cpu_execute(
 		mii_cpu_t *cpu,
-		mii_cpu_state_t s)
+		mii_cpu_state_t s,
+		const uint8_t ir,
+		const mii_cpu_decoded_t *dc)
 {
-#if MII_65C02_DIRECT_ACCESS
-	mii_op_desc_t d;
-#else
-	mii_op_desc_t d = mii_cpu_op[cpu->IR].desc;
-	pt_start(cpu->state);
-#endif
-next_instruction:
-	if (unlikely(s.reset)) {
-		s.reset = 0;
-		_FETCH(0xfffc); cpu->cpu_P = s.data;
-		_FETCH(0xfffd);	cpu->cpu_P |= s.data << 8;
-		cpu->PC = cpu->cpu_P;
-	  	cpu->S = 0xFF;
-		MII_SET_P(cpu, 0);
-	}
-	if (unlikely(s.irq && cpu->P.I == 0)) {
-		if (!cpu->IRQ)
-			cpu->IRQ = MII_CPU_IRQ_IRQ;
-	}
-	if (unlikely(s.nmi && cpu->P.I == 0)) {
-		if (!cpu->IRQ)
-			cpu->IRQ = MII_CPU_IRQ_NMI;
-	}
-	if (unlikely(cpu->IRQ)) {
-		s.irq = 0;
-		cpu->P.B = cpu->IRQ == MII_CPU_IRQ_BRK;
-		cpu->cpu_D = cpu->PC;
-		_STORE(0x0100 | cpu->S--, cpu->cpu_D >> 8);
-		_STORE(0x0100 | cpu->S--, cpu->cpu_D & 0xff);
-		uint8_t p = 0;
-		MII_GET_P(cpu, p);
-		_STORE(0x0100 | cpu->S--, p);
-		cpu->P.I = 1;
-		if (cpu->IRQ == MII_CPU_IRQ_BRK)
-			cpu->P.D = 0;
-		if (cpu->IRQ == MII_CPU_IRQ_NMI) {
-		//	printf("NMI!\n");
-			_FETCH(0xfffa); cpu->cpu_P = s.data;
-			_FETCH(0xfffb);	cpu->cpu_P |= s.data << 8;
-		} else {
-			_FETCH(0xfffe); cpu->cpu_P = s.data;
-			_FETCH(0xffff);	cpu->cpu_P |= s.data << 8;
-		}
-		cpu->IRQ = 0;
-		cpu->PC = cpu->cpu_P;
-	}
-	s.sync = 1;
-	// we dont' reset the cycle here, that way calling code has a way of knowing
-	// how many cycles were used by the previous instruction
-	_FETCH(cpu->PC);
-	cpu->total_cycle += cpu->cycle;
-	s.sync = 0;
-	cpu->cycle = 0;
-	cpu->PC++;
-	cpu->IR = s.data;
-	d = mii_cpu_op[cpu->IR].desc;
-	cpu->ir_log = (cpu->ir_log << 8) | cpu->IR;
-	s.trap = cpu->trap && (cpu->ir_log & 0xffff) == cpu->trap;
-	if (unlikely(s.trap)) {
-		cpu->ir_log = 0;
-#if MII_65C02_DIRECT_ACCESS
-		return s;
-#endif
-	}
+	const mii_op_desc_t d = mii_cpu_op[ir].desc;
+	uint16_t operand = dc ? dc->operand : 0;
+
 	switch (d.mode) {
 		case IMM:
-			_FETCH(cpu->PC++);		cpu->cpu_D = s.data;
+			_FETCH_OPERAND();		cpu->cpu_D = s.data;
 			break;
 		case BRANCH: // BEQ/BNE etc
 		case ZP_REL: // $(xx)
-			_FETCH(cpu->PC++);		cpu->cpu_P = s.data;
+			_FETCH_OPERAND();		cpu->cpu_P = s.data;
 			break;
 		case ZP_X: // $xx,X
-			_FETCH(cpu->PC++);		cpu->cpu_P = (s.data + cpu->X) & 0xff;
+			_FETCH_OPERAND();		cpu->cpu_P = (s.data + cpu->X) & 0xff;
 			break;
 		case ZP_Y:	// $xx,Y
-			_FETCH(cpu->PC++);		cpu->cpu_P = (s.data + cpu->Y) & 0xff;
+			_FETCH_OPERAND();		cpu->cpu_P = (s.data + cpu->Y) & 0xff;
 			break;
 		case ABS: {	// $xxxx
-			_FETCH(cpu->PC++);		cpu->cpu_P = s.data;
-			_FETCH(cpu->PC++);		cpu->cpu_P |= s.data << 8;
+			_FETCH_OPERAND();		cpu->cpu_P = s.data;
+			_FETCH_OPERAND();		cpu->cpu_P |= s.data << 8;
 		}	break;
 		case ABS_X: { // $xxxx,X
-			_FETCH(cpu->PC++);		cpu->cpu_P = s.data;
-			_FETCH(cpu->PC++);		cpu->cpu_P |= s.data << 8;
+			_FETCH_OPERAND();		cpu->cpu_P = s.data;
+			_FETCH_OPERAND();		cpu->cpu_P |= s.data << 8;
 			/*
 			 * this seems to be only used by a2audit, ever, which is bloody
 			 * annoying, so we just fake it to pass the test
 			 */
-			if (cpu->IR == 0xfe && cpu->X == 0 && cpu->cpu_P == 0xc083) {
+			if (ir == 0xfe && cpu->X == 0 && cpu->cpu_P == 0xc083) {
 			//	printf("Fooling a2audit\n");
 				_FETCH(cpu->cpu_P);	// false read
 			}
@@ -255,43 +506,43 @@ next_instruction:
 			}
 		}	break;
 		case ABS_Y: { // $xxxx,Y
-			_FETCH(cpu->PC++);		cpu->cpu_P = s.data;
-			_FETCH(cpu->PC++);		cpu->cpu_P |= s.data << 8;
+			_FETCH_OPERAND();		cpu->cpu_P = s.data;
+			_FETCH_OPERAND();		cpu->cpu_P |= s.data << 8;
 			cpu->cpu_P += cpu->Y;
 			if ((cpu->cpu_P & 0xff00) != (s.data << 8)) {
 				_FETCH(cpu->PC); // false read
 			}
 		}	break;
 		case IND_X: { // ($xx,X)
-			_FETCH(cpu->PC++);		cpu->cpu_D = s.data;
+			_FETCH_OPERAND();		cpu->cpu_D = s.data;
 			cpu->cpu_D += cpu->X;
 			_FETCH(cpu->cpu_D & 0xff);	cpu->cpu_P = s.data;
 			cpu->cpu_D++;
 			_FETCH(cpu->cpu_D & 0xff);	cpu->cpu_P |= s.data << 8;
 		}	break;
 		case IND_Y: { // ($xx),Y
-			_FETCH(cpu->PC++);		cpu->cpu_D = s.data;
+			_FETCH_OPERAND();		cpu->cpu_D = s.data;
 			_FETCH(cpu->cpu_D);		cpu->cpu_P = s.data;
 			_FETCH((cpu->cpu_D + 1) & 0xff);
 			cpu->cpu_P |= s.data << 8;
 			cpu->cpu_P += cpu->Y;
 		}	break;
 		case IND: {	// ($xxxx)
-			_FETCH(cpu->PC++); 		cpu->cpu_D = s.data;
-			_FETCH(cpu->PC++); 		cpu->cpu_D |= s.data << 8;
+			_FETCH_OPERAND(); 		cpu->cpu_D = s.data;
+			_FETCH_OPERAND(); 		cpu->cpu_D |= s.data << 8;
 			_FETCH(cpu->cpu_D); 		cpu->cpu_P = s.data;
 			_FETCH(cpu->cpu_D + 1); 	cpu->cpu_P |= s.data << 8;
 		}	break;
 		case IND_Z: {	// ($xx)
-			_FETCH(cpu->PC++); 		cpu->cpu_D = s.data;
+			_FETCH_OPERAND(); 		cpu->cpu_D = s.data;
 			_FETCH(cpu->cpu_D); 		cpu->cpu_P = s.data;
 //			_FETCH((cpu->cpu_D + 1)); 	cpu->cpu_P |= s.data << 8;
 			// FD if $xx=0xFF then 0xFF+1 = 0x00 and not 0x100 bug fixed
 			_FETCH((cpu->cpu_D + 1) & 0xFF); 	cpu->cpu_P |= s.data << 8;
 		}	break;
 		case IND_AX: { // ($xxxx,X)
-			_FETCH(cpu->PC++);		cpu->cpu_D = s.data;
-			_FETCH(cpu->PC++);		cpu->cpu_D |= s.data << 8;
+			_FETCH_OPERAND();		cpu->cpu_D = s.data;
+			_FETCH_OPERAND();		cpu->cpu_D |= s.data << 8;
 			cpu->cpu_D += cpu->X;
 			if ((cpu->cpu_D & 0xff00) != (s.data << 8))
 				cpu->cycle++;
@@ -303,12 +554,17 @@ next_instruction:
 		_FETCH(cpu->cpu_P);
 		cpu->cpu_D = s.data;
 	}
-	switch (cpu->IR) {
+	switch (ir) {
 		case 0x69: case 0x65: case 0x75: case 0x6D: case 0x7D:
 		case 0x79: case 0x61: case 0x71: case 0x72:
 		{ // ADC
 			// Handle adding in BCD with bit D
 			if (unlikely(cpu->P.D)) {
+#if MII_65C02_BCD_TABLES
+				cpu->A = _mii_cpu_bcd_add(cpu, cpu->A, cpu->cpu_D);
+				cpu->P.N = !!(cpu->A & 0x80);
+				cpu->P.Z = cpu->A == 0;
+#else
 				uint8_t D = cpu->cpu_D;
 				uint8_t lo = (cpu->A & 0x0f) + (D & 0x0f) + !!cpu->P.C;
 				if (lo > 9) lo += 6;
@@ -328,6 +584,7 @@ next_instruction:
 				cpu->P.N = !!(cpu->A & 0x80);
 				// FD THAT is 65C02 behavior
                 cpu->P.Z = cpu->A == 0;
+#endif
 			} else {
 				uint16_t sum = cpu->A + cpu->cpu_D + !!cpu->P.C;
 				cpu->P.V = cpu->P.C = 0;
@@ -363,7 +620,7 @@ next_instruction:
 		{ // BBR/BBS
 //			printf(" BB%c%d vs %02x\n", d.s_bit_value ? 'S' : 'R',
 //					d.s_bit, cpu->cpu_D);
-			_FETCH(cpu->PC++);	// relative branch
+			_FETCH_OPERAND();	// relative branch
 			if (((cpu->cpu_D >> d.s_bit) & 1) == d.s_bit_value) {
 				cpu->cpu_P = cpu->PC + (int8_t)s.data;
 				cpu->cycle++;
@@ -380,6 +637,24 @@ next_instruction:
 				cpu->cycle++;
 				if ((cpu->cpu_P & 0xff00) != (cpu->PC & 0xff00))
 					cpu->cycle++;
+#if MII_RP2350 && MII_65C02_IDLE_SKIP
+				// back to the instruction before us, might be polling
+				if (unlikely(cpu->cpu_P == (uint16_t)(cpu->PC - 5))) {
+					_CPU_SAVE();
+					_mii_cpu_idle_skip(_CPU_REAL(), s);
+					_CPU_LOAD();
+				}
+#endif
+#if MII_RP2350 && MII_65C02_LOOP_SKIP
+				// BNE back to a DEX, DEY, SBC #1 etc, might be a delay loop
+				if (ir == 0xd0 && unlikely(
+						cpu->cpu_P == (uint16_t)(cpu->PC - 3) ||
+						cpu->cpu_P == (uint16_t)(cpu->PC - 4))) {
+					_CPU_SAVE();
+					_mii_cpu_loop_skip(_CPU_REAL(), s);
+					_CPU_LOAD();
+				}
+#endif
 				cpu->PC = cpu->cpu_P;
 			}
 		}	break;
@@ -405,7 +680,7 @@ next_instruction:
 		{ // BRK
 			// Turns out BRK is a 2 byte opcode, who knew? well that guy did:
 			// https://www.nesdev.org/the%20'B'%20flag%20&%20BRK%20instruction.txt#:~:text=A%20note%20on%20the%20BRK,opcode%2C%20and%20not%20just%201.
-			_FETCH(cpu->PC++);
+			_FETCH_OPERAND();
 			s.irq = 1;
 			cpu->IRQ = MII_CPU_IRQ_BRK;		// BRK sort of IRQ interrupt
 		}	break;
@@ -486,11 +761,11 @@ next_instruction:
 		case 0x20:
 		// https://github.com/AppleWin/AppleWin/issues/1257
 		{ // JSR
-			_FETCH(cpu->PC++);		cpu->cpu_P = s.data;
+			_FETCH_OPERAND();		cpu->cpu_P = s.data;
 			_FETCH(0x0100 | cpu->S);
 			_STORE(0x0100 | cpu->S--, cpu->PC >> 8);
 			_STORE(0x0100 | cpu->S--, cpu->PC & 0xff);
-			_FETCH(cpu->PC++);		cpu->cpu_P |= s.data << 8;
+			_FETCH_OPERAND();		cpu->cpu_P |= s.data << 8;
 			cpu->PC = cpu->cpu_P;
 		}	break;
 		case 0xA9: case 0xA5: case 0xB5: case 0xAD: case 0xBD:
@@ -636,7 +911,12 @@ next_instruction:
 		{ // SBC
 			// Handle subbing in BCD with bit D
 			if (unlikely(cpu->P.D)) {
-#if 1
+#if MII_65C02_BCD_TABLES
+				uint8_t D = 0x99 - cpu->cpu_D;
+				cpu->P.Z = ((uint8_t)(cpu->A + D + cpu->P.C)) == 0;
+				cpu->A = _mii_cpu_bcd_add(cpu, cpu->A, D);
+				cpu->P.N = !!(cpu->A & 0x80);
+#elif 1
 				uint8_t D = 0x99 - cpu->cpu_D;
 				// verbatim ADC code here
 				uint8_t lo = (cpu->A & 0x0f) + (D & 0x0f) + !!cpu->P.C;
@@ -760,17 +1040,17 @@ next_instruction:
 		}	break;
 		/* Apparently these NOPs use 3 bytes, according to the tests */
 		case 0x5c: case 0xdc: case 0xfc:
-			_FETCH(cpu->PC++);
+			_FETCH_OPERAND();
 			// fall through
 		/* Apparently these NOPs use 2 bytes, according to the tests */
 		case 0x02: case 0x22: case 0x42: case 0x62: case 0x82:
 		case 0xC2: case 0xE2: case 0x44: case 0x54: case 0xD4:
 		case 0xF4:
-			_FETCH(cpu->PC++);	// consume that byte
+			_FETCH_OPERAND();	// consume that byte
 			break;
 		case 0xdb:
 		// trap NOPs / STP (WDC)
-			_FETCH(cpu->PC++); // FD: Added to pass HARTE's test
+			_FETCH_OPERAND(); // FD: Added to pass HARTE's test
 			break;
 		case 0xCB :
 		// FD: Added to pass HARTE's test
@@ -787,22 +1067,178 @@ next_instruction:
 			//  NOPs
 			break;
 		default:
-			MII_DEBUG_PRINTF("%04x %02x UNKNOWN INSTRUCTION\n", cpu->PC, cpu->IR);
+			MII_DEBUG_PRINTF("%04x %02x UNKNOWN INSTRUCTION\n", cpu->PC, ir);
 		//	exit(1);
 			break;
 	}
 	if (d.w) {
 		_STORE(cpu->cpu_P, cpu->cpu_D);
 	}
-#if MII_65C02_DIRECT_ACCESS
+	return s;
+}
+
+/*
+ * Fetches the next opcode, handles the trap sequence. This is shared by the
+ * main loop and the tail of every threaded handler.
+ */
+#define _FETCH_OPCODE() { \
+		s.sync = 1; \
+		/* we dont' reset the cycle here, that way calling code has a way of */ \
+		/* knowing how many cycles were used by the previous instruction */ \
+		dc = _DECODED(cpu->PC); \
+		if (dc) { \
+			s.addr = cpu->PC; s.w = 0; cpu->cycle++; \
+			s.data = dc->ir; \
+		} else \
+			_FETCH(cpu->PC); \
+		cpu->total_cycle += cpu->cycle; \
+		s.sync = 0; \
+		cpu->cycle = 0; \
+		cpu->PC++; \
+		cpu->IR = s.data; \
+		cpu->ir_log = (cpu->ir_log << 8) | cpu->IR; \
+		s.trap = cpu->trap && (cpu->ir_log & 0xffff) == cpu->trap; \
+		if (unlikely(s.trap)) { \
+			cpu->ir_log = 0; \
+			_CPU_SAVE(); \
+			return s; \
+		} \
+		_ROM_HOOK(); \
+	}
+
+/* the routine is done, carry on with the instruction it returned to */
+#if MII_RP2350 && MII_65C02_ROM_HOOKS
+#define _ROM_HOOK() \
+		if (unlikely(dc && dc->hook)) { \
+			_CPU_SAVE(); \
+			bool _done = _mii_cpu_rom_hook(_CPU_REAL(), s, dc->hook); \
+			_CPU_LOAD(); \
+			if (_done) \
+				goto next_instruction; \
+		}
+#else
+#define _ROM_HOOK()
+#endif
+
+// s.reset, s.irq and s.nmi, tested in one go between instructions
+#define _S_EVENTS \
+		(((mii_cpu_state_t){ .reset = 1, .irq = 1, .nmi = 1 }).raw)
+
+#if MII_65C02_THREADED
+/*
+ * Threaded dispatch; one handler per opcode, generated from the
+ * mii_cpu_op[] table, and each handler jumps straight into the next one
+ * unless something (reset, IRQ, BRK, end of the batch) needs the main loop.
+ */
+#define _OPS_ROW(_x, _h) \
+	_x(0x##_h##0) _x(0x##_h##1) _x(0x##_h##2) _x(0x##_h##3) \
+	_x(0x##_h##4) _x(0x##_h##5) _x(0x##_h##6) _x(0x##_h##7) \
+	_x(0x##_h##8) _x(0x##_h##9) _x(0x##_h##A) _x(0x##_h##B) \
+	_x(0x##_h##C) _x(0x##_h##D) _x(0x##_h##E) _x(0x##_h##F)
+#define _OPS(_x) \
+	_OPS_ROW(_x, 0) _OPS_ROW(_x, 1) _OPS_ROW(_x, 2) _OPS_ROW(_x, 3) \
+	_OPS_ROW(_x, 4) _OPS_ROW(_x, 5) _OPS_ROW(_x, 6) _OPS_ROW(_x, 7) \
+	_OPS_ROW(_x, 8) _OPS_ROW(_x, 9) _OPS_ROW(_x, A) _OPS_ROW(_x, B) \
+	_OPS_ROW(_x, C) _OPS_ROW(_x, D) _OPS_ROW(_x, E) _OPS_ROW(_x, F)
+
+#define _OP_LABEL(_op) 	&&op_##_op,
+#define _OP_HANDLER(_op) \
+	op_##_op: \
+		s = _mii_cpu_execute(cpu, s, _op, dc); \
+		if (unlikely(!cpu->instruction_run || cpu->IRQ || \
+				cpu->total_cycle + cpu->cycle >= cpu->cycle_limit || \
+				(s.raw & _S_EVENTS) || _IRQ_TAKEN(cpu))) \
+			goto instruction_done; \
+		cpu->instruction_run--; \
+		_FETCH_OPCODE(); \
+		goto *op_table[cpu->IR];
+#endif
+
+mii_cpu_state_t
+mii_cpu_run(
+		mii_cpu_t *_cpu,
+		mii_cpu_state_t s,
+		uint64_t deadline)
+{
+#if MII_RP2350 && MII_65C02_LOCAL_REGS
+	// registers are kept in a local copy for the run, see _CPU_SAVE()
+	mii_cpu_t regs = *_cpu;
+	mii_cpu_t *cpu = &regs;
+#else
+	mii_cpu_t *cpu = _cpu;
+#endif
+#if MII_65C02_THREADED
+	static const void * const op_table[256] = { _OPS(_OP_LABEL) };
+#endif
+	const mii_cpu_decoded_t *dc = NULL;
+	cpu->cycle_limit = deadline;
+#if MII_RP2350 && MII_65C02_IDLE_SKIP
+	cpu->run_start = cpu->total_cycle + cpu->cycle;
+#endif
+next_instruction:
+	if (likely(!((s.raw & _S_EVENTS) | _IRQ_TAKEN(cpu) | cpu->IRQ)))
+		goto fetch_opcode;
+	if (unlikely(s.reset)) {
+		s.reset = 0;
+		_FETCH(0xfffc); cpu->cpu_P = s.data;
+		_FETCH(0xfffd);	cpu->cpu_P |= s.data << 8;
+		cpu->PC = cpu->cpu_P;
+	  	cpu->S = 0xFF;
+		MII_SET_P(cpu, 0);
+	}
+	if (unlikely((s.irq || cpu->irq_pending) && cpu->P.I == 0)) {
+		if (!cpu->IRQ)
+			cpu->IRQ = MII_CPU_IRQ_IRQ;
+	}
+	if (unlikely(s.nmi && cpu->P.I == 0)) {
+		if (!cpu->IRQ)
+			cpu->IRQ = MII_CPU_IRQ_NMI;
+	}
+	if (unlikely(cpu->IRQ)) {
+		s.irq = 0;
+		cpu->P.B = cpu->IRQ == MII_CPU_IRQ_BRK;
+		cpu->cpu_D = cpu->PC;
+		_STORE(0x0100 | cpu->S--, cpu->cpu_D >> 8);
+		_STORE(0x0100 | cpu->S--, cpu->cpu_D & 0xff);
+		uint8_t p = 0;
+		MII_GET_P(cpu, p);
+		_STORE(0x0100 | cpu->S--, p);
+		cpu->P.I = 1;
+		if (cpu->IRQ == MII_CPU_IRQ_BRK)
+			cpu->P.D = 0;
+		else
+			cpu->irq_vector_cycle = cpu->total_cycle + cpu->cycle;
+		if (cpu->IRQ == MII_CPU_IRQ_NMI) {
+		//	printf("NMI!\n");
+			_FETCH(0xfffa); cpu->cpu_P = s.data;
+			_FETCH(0xfffb);	cpu->cpu_P |= s.data << 8;
+		} else {
+			_FETCH(0xfffe); cpu->cpu_P = s.data;
+			_FETCH(0xffff);	cpu->cpu_P |= s.data << 8;
+		}
+		cpu->IRQ = 0;
+		cpu->PC = cpu->cpu_P;
+		// the vector is a boundary too, a short run stops at the handler
+		if (unlikely(cpu->total_cycle + cpu->cycle >= cpu->cycle_limit)) {
+			_CPU_SAVE();
+			return s;
+		}
+	}
+fetch_opcode:
+	_FETCH_OPCODE();
+#if MII_65C02_THREADED
+	goto *op_table[cpu->IR];
+	_OPS(_OP_HANDLER)
+instruction_done:
+#else
+	s = _mii_cpu_execute(cpu, s, cpu->IR, dc);
+#endif
 	// we don't need to do anything here, the store already did it
-	if (likely(cpu->instruction_run)) {
+	if (likely(cpu->instruction_run &&
+			cpu->total_cycle + cpu->cycle < cpu->cycle_limit)) {
 		cpu->instruction_run--;
 		goto next_instruction;
 	}
-#else
-	goto next_instruction;
-	pt_end(cpu->state);
-#endif
+	_CPU_SAVE();
 	return s;
 }
@@ -64,6 +64,84 @@ enum {
 #ifndef MII_65C02_DIRECT_ACCESS
 #define MII_65C02_DIRECT_ACCESS		1
 #endif
+/*
+ * Use a computed-goto threaded dispatch (one handler per opcode) instead of
+ * the big switch in mii_cpu_run(). Both produce the exact same bus accesses
+ * and cycle counts; this is purely a speed tradeoff (larger code).
+ */
+#ifndef MII_65C02_THREADED
+#define MII_65C02_THREADED			0
+#endif
+/*
+ * Run on a local copy of the CPU registers for the whole mii_cpu_run(),
+ * written back to mii->cpu around I/O and on return. This wins with the
+ * threaded core, but the switch core runs out of host registers and gets
+ * slower, so it follows MII_65C02_THREADED by default. RP2350 only.
+ */
+#ifndef MII_65C02_LOCAL_REGS
+#define MII_65C02_LOCAL_REGS		MII_65C02_THREADED
+#endif
+/*
+ * Bump the write generation counter of the page (mii_bank_t.gen) on every
+ * store, so the video etc can tell what guest memory changed, see
+ * mii_bank_changed(). The generic core always counts, as it
+ * writes through mii_bank_write(). RP2350 only.
+ */
+#ifndef MII_65C02_WRITE_GEN
+#define MII_65C02_WRITE_GEN			1
+#endif
+
+/*
+ * Fast-forward 2 instruction polling loops ('LDA $C000 / BPL *-3' etc) to
+ * the next timer deadline, the result is the same as running them, just
+ * quicker. RP2350 only.
+ */
+#ifndef MII_65C02_IDLE_SKIP
+#define MII_65C02_IDLE_SKIP			1
+#endif
+/*
+ * Fast-forward register only delay loops ('DEX / BNE *-1', 'SBC #1 /
+ * BNE *-2' as in the Monitor WAIT etc) up to their last iteration, or the
+ * next timer deadline. RP2350 only.
+ */
+#ifndef MII_65C02_LOOP_SKIP
+#define MII_65C02_LOOP_SKIP			1
+#endif
+
+/*
+ * Let native versions of ROM routines (Monitor WAIT etc) run instead of
+ * the ROM code, see mii_rom_hook_register(). They only trigger from the
+ * pre-decoded ROM, so only when the ROM is mapped. RP2350 only.
+ */
+#ifndef MII_65C02_ROM_HOOKS
+#define MII_65C02_ROM_HOOKS			1
+#endif
+
+/*
+ * Decimal mode ADC/SBC with two 512 byte nibble tables instead of the
+ * nibble arithmetic and its branches. Same A and flags.
+ */
+#ifndef MII_65C02_BCD_TABLES
+#define MII_65C02_BCD_TABLES		1
+#endif
+
+#if MII_65C02_IDLE_SKIP
+typedef struct mii_cpu_idle_stats_t {
+	uint32_t	loops;		// polling loops fast-forwarded
+	uint32_t	cycles;		// emulated cycles skipped
+} mii_cpu_idle_stats_t;
+
+extern mii_cpu_idle_stats_t mii_cpu_idle_stats;
+#endif
+
+#if MII_65C02_LOOP_SKIP
+typedef struct mii_cpu_loop_stats_t {
+	uint32_t	loops;		// delay loops fast-forwarded
+	uint32_t	cycles;		// emulated cycles skipped
+} mii_cpu_loop_stats_t;
+
+extern mii_cpu_loop_stats_t mii_cpu_loop_stats;
+#endif
 
 #if MII_65C02_DIRECT_ACCESS
 struct mii_cpu_t;
@@ -111,10 +189,23 @@ typedef struct mii_cpu_t {
 	 * typically use a pair of NOPs sequence that is unlikely to exist in
 	 * real code. */
 	uint16_t 	trap;
+	/* Interrupt sources holding the IRQ line low, one bit each, see
+	 * mii_irq_raise(). Checked between instructions, like s.irq */
+	uint16_t	irq_pending;
 	// last 4 instructions, as a shift register, used for traps or debug
 	uint32_t	ir_log;
 
 	uint64_t 	total_cycle;
+	// stop at the first instruction boundary at or after this total_cycle
+	uint64_t	cycle_limit;
+	// total_cycle of the last IRQ/NMI vector fetch, for the latency stats
+	uint64_t	irq_vector_cycle;
+#if MII_65C02_IDLE_SKIP
+	// total_cycle when mii_cpu_run() was called; the world can only
+	// change in between calls, so a polling loop is only skipped after
+	// it has read its I/O location within the same call
+	uint64_t	run_start;
+#endif
 #if MII_65C02_DIRECT_ACCESS
 	mii_cpu_direct_access_cb access;
 	void *					access_param;	// typically struct mii_t*
@@ -129,14 +220,42 @@ typedef struct mii_cpu_t {
 #endif
 } mii_cpu_t;
 
+/*
+ * Pre-decoded instruction, used for code that never changes (ROM). The
+ * operand holds the two bytes following the opcode, so the core doesn't
+ * need to go through the memory map to fetch them.
+ */
+typedef struct mii_cpu_decoded_t {
+	uint8_t		ir;
+	uint8_t		hook;		// ROM hook number + 1, 0 for none
+	uint16_t	operand;
+} mii_cpu_decoded_t;
+
 mii_cpu_state_t
 mii_cpu_init(
 		mii_cpu_t *cpu );
 
+/*
+ * Decode 'count' bytes of 'mem' into 'out' (one entry per address).
+ * The last two entries have partial operands, the caller is responsible
+ * for not using them.
+ */
+void
+mii_cpu_decode(
+		const uint8_t *mem,
+		uint32_t count,
+		mii_cpu_decoded_t *out );
+
+/*
+ * Run instructions until either instruction_run runs out, or the end of
+ * an instruction reaches 'deadline' (in total_cycle). cycle_limit starts
+ * at 'deadline', and can be lowered while running (a new timer event).
+ */
 mii_cpu_state_t
 mii_cpu_run(
 		mii_cpu_t *cpu,
-		mii_cpu_state_t s);
+		mii_cpu_state_t s,
+		uint64_t deadline);
 
 
 #ifdef MII_PACK_P
@@ -81,12 +81,52 @@ mii_bank_write(
 		return;
 	}
 	#endif
-	if (mii_bank_access(bank, addr, data, len, true))
-		return;
 	uint32_t phy = bank->mem_offset + addr - bank->base;
-	do {
-		bank->mem[phy++] = *data++;
-	} while (likely(--len));
+	while (len) {
+		uint16_t run = 0x100 - (addr & 0xff);
+		if (run > len)
+			run = len;
+		mii_bank_access_t *a = bank->access ?
+				&bank->access[(addr - bank->base) >> 8] : NULL;
+		if (unlikely(a && a->cb)) {
+			for (int i = 0; i < run; i++)
+				if (!a->cb(bank, a->param, addr + i, (uint8_t *)data + i, true))
+					bank->mem[phy + i] = data[i];
+		} else
+			memcpy(bank->mem + phy, data, run);
+		if (bank->gen)
+			bank->gen[phy >> 8]++;
+		addr += run;
+		phy += run;
+		data += run;
+		len -= run;
+	}
+}
+
+uint16_t
+mii_bank_changed(
+		mii_bank_t *bank,
+		uint16_t addr1,
+		uint16_t addr2,
+		uint32_t *snap,
+		uint32_t *changed)
+{
+	uint32_t page = (bank->mem_offset + addr1 - bank->base) >> 8;
+	uint16_t count = (addr2 >> 8) - (addr1 >> 8) + 1;
+	uint16_t res = 0;
+
+	if (changed)
+		memset(changed, 0, ((count + 31) / 32) * sizeof(*changed));
+	for (int i = 0; i < count; i++) {
+		uint32_t gen = bank->gen ? bank->gen[page + i] : snap[i] + 1;
+		if (gen == snap[i])
+			continue;
+		snap[i] = gen;
+		res++;
+		if (changed)
+			changed[i / 32] |= 1u << (i % 32);
+	}
+	return res;
 }
 
 void
@@ -105,12 +145,24 @@ mii_bank_read(
 		return;
 	}
 	#endif
-	if (mii_bank_access(bank, addr, data, len, false))
-		return;
 	uint32_t phy = bank->mem_offset + addr - bank->base;
-	do {
-		*data++ = bank->mem[phy++];
-	} while (likely(--len));
+	while (len) {
+		uint16_t run = 0x100 - (addr & 0xff);
+		if (run > len)
+			run = len;
+		mii_bank_access_t *a = bank->access ?
+				&bank->access[(addr - bank->base) >> 8] : NULL;
+		if (unlikely(a && a->cb)) {
+			for (int i = 0; i < run; i++)
+				if (!a->cb(bank, a->param, addr + i, data + i, false))
+					data[i] = bank->mem[phy + i];
+		} else
+			memcpy(data, bank->mem + phy, run);
+		addr += run;
+		phy += run;
+		data += run;
+		len -= run;
+	}
 }
 
 
@@ -45,6 +45,10 @@ typedef struct mii_bank_t {
 	mii_bank_access_t * access;
 	uint8_t		*mem;
 	uint32_t 	mem_offset;
+	/* Optional write generation counter for each page of 'mem' (indexed
+	 * like mem, so banks sharing memory share the counters), bumped on
+	 * every write. Used to invalidate anything cached from that memory */
+	uint32_t	*gen;
 } mii_bank_t;
 
 void
@@ -53,6 +57,11 @@ mii_bank_init(
 void
 mii_bank_dispose(
 		mii_bank_t *bank);
+/*
+ * Copy 'len' bytes to/from the bank; pages with an access callback get it
+ * called for each byte (the bank is used if it returns false), the others
+ * are copied in one go.
+ */
 void
 mii_bank_write(
 		mii_bank_t *bank,
@@ -73,13 +82,21 @@ mii_bank_access(
 		uint16_t len,
 		bool write);
 
-/* return the number of pages dirty (written into since last time) between
- * addr1 and addr2 (inclusive) */
-uint8_t
-mii_bank_is_dirty(
+/*
+ * Compare the write generation of the pages between addr1 and addr2
+ * (inclusive) with 'snap', a caller owned array with one entry per page of
+ * that range, and update it. Returns the number of pages written to since,
+ * and sets their bit in the 'changed' bitmap (one bit per page, optional).
+ * Fill 'snap' with 0xff to get every page on the first call. Banks without
+ * generation counters always report every page.
+ */
+uint16_t
+mii_bank_changed(
 		mii_bank_t *bank,
 		uint16_t addr1,
-		uint16_t addr2);
+		uint16_t addr2,
+		uint32_t *snap,
+		uint32_t *changed);
 void
 mii_bank_install_access_cb(
 		mii_bank_t *bank,
@@ -108,6 +125,8 @@ mii_bank_poke(
 {
 	uint32_t phy = bank->mem_offset + addr - bank->base;
 	bank->mem[phy] = data;
+	if (bank->gen)
+		bank->gen[phy >> 8]++;
 }
 #else
 static inline void
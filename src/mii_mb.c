@@ -21,21 +21,34 @@ typedef struct mii_mb_t {
 } mii_mb_t;
 
 
+/*
+ * Bring the VIAs up to date; the card IRQ is held as long as one of them
+ * has an interrupt active, and released when the code acknowledges it.
+ */
+static void
+_mii_mb_sync(
+		mii_mb_t * mb)
+{
+	mii_t * mii = mb->mii;
+	mb_clock_t clock = {
+		.ref_step = MB_CLOCKS_PHI0_CYCLE,
+		.ts = mii->cpu.total_cycle * MB_CLOCKS_14MHZ_CYCLE,
+	};
+	if (mb_io_sync(mb->mb, &clock) & MB_CARD_IRQ)
+		mii_irq_raise(mii, mb->irq_num);
+	else
+		mii_irq_clear(mii, mb->irq_num);
+}
+
 static uint64_t
 _mii_mb_timer(
 		mii_t * mii,
 		void * param )
 {
 	mii_mb_t * mb = param;
-	mb_clock_t clock = {
-		.ref_step = MB_CLOCKS_PHI0_CYCLE,
-		.ts = mii->cpu.total_cycle * MB_CLOCKS_14MHZ_CYCLE,
-	};
 	uint64_t res = 1 + -mii_timer_get(mii, mb->timer);
 
-	uint32_t irq = mb_io_sync(mb->mb, &clock);
-	if (irq & MB_CARD_IRQ)
-		mii->cpu_state.irq = 1;
+	_mii_mb_sync(mb);
 
 	if ((mii->cpu.total_cycle - mb->last_flush_cycle) >= mb->flush_cycle_count) {
 		mb->last_flush_cycle = mii->cpu.total_cycle;
@@ -108,8 +121,10 @@ _mii_mb_romspace_access(
 				}
 			//	printf("%s: %s addr %04x byte %02x write %d\n", __func__, bank->name, addr, *byte, write);
 				mb_io_write(mb->mb, *byte, addr & 0xff);
+				_mii_mb_sync(mb);
 			} else if (mb->init_done) {
 				mb_io_read(mb->mb, byte, addr & 0xff);
+				_mii_mb_sync(mb);	// reading T1C-L acknowledges
 			}
 		//	printf("%s: %s addr %04x byte %02x write %d\n", __func__,
 		//			bank->name, addr, *byte, write);
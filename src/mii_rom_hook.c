@@ -0,0 +1,238 @@
+/*
+ * mii_rom_hook.c
+ *
+ * Native versions of hot Monitor ROM routines, see mii_rom_hook_cb.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "mii.h"
+#include "debug_log.h"
+
+int
+mii_rom_hook_register(
+		mii_t *mii,
+		uint16_t addr,
+		const char *name,
+		mii_rom_hook_cb cb)
+{
+	if (mii->rom_hook.count >= MII_ROM_HOOK_COUNT ||
+			addr < MII_ROM_DECODED_BASE)
+		return -1;
+	int id = mii->rom_hook.count++;
+	mii->rom_hook.hook[id] = (mii_rom_hook_t) {
+		.addr = addr,
+		.name = name,
+		.cb = cb,
+	};
+	mii_rom_hook_enable(mii, mii->rom_hook.enabled);
+	return id;
+}
+
+void
+mii_rom_hook_enable(
+		mii_t *mii,
+		bool enable)
+{
+	mii->rom_hook.enabled = enable;
+	if (!mii->rom_decoded)
+		return;
+	for (int i = 0; i < mii->rom_hook.count; i++) {
+		mii_rom_hook_t *h = &mii->rom_hook.hook[i];
+		mii->rom_decoded[h->addr - MII_ROM_DECODED_BASE].hook =
+				enable ? i + 1 : 0;
+	}
+}
+
+/*
+ * The routines only touch the zero page and the stack, these are never
+ * I/O, so the page tables can be used directly, like the CPU does.
+ */
+static inline uint8_t
+_hook_read(
+		mii_t *mii,
+		uint16_t addr)
+{
+	return mii->mem_read[addr >> 8][addr & 0xff];
+}
+
+static inline void
+_hook_write(
+		mii_t *mii,
+		uint16_t addr,
+		uint8_t data)
+{
+	mii->mem_write[addr >> 8][addr & 0xff] = data;
+	(*mii->mem_write_gen[addr >> 8])++;
+}
+
+static inline void
+_hook_rts(
+		mii_t *mii)
+{
+	mii_cpu_t *cpu = &mii->cpu;
+	uint16_t pc = _hook_read(mii, 0x100 | ++cpu->S);
+	pc |= _hook_read(mii, 0x100 | ++cpu->S) << 8;
+	cpu->PC = pc + 1;
+}
+
+/* SBC #$01, binary mode */
+static inline uint8_t
+_hook_sbc1(
+		uint8_t a,
+		uint8_t *c,
+		uint8_t *v)
+{
+	uint16_t r = a - 1 - !*c;
+	*v = !!((a ^ 0x01) & (a ^ r) & 0x80);
+	*c = !(r & 0xff00);
+	return r;
+}
+
+/*
+ * WAIT ($FCA8), delays 2.5A^2 + 13.5A + 7 cycles (plus the JSR)
+ *
+ *	SEC
+ *	PHA
+ *	SBC #$01
+ *	BNE *-2
+ *	PLA
+ *	SBC #$01
+ *	BNE *-8
+ *	RTS
+ */
+static uint32_t
+_mii_hook_wait(
+		mii_t *mii,
+		uint32_t budget)
+{
+	mii_cpu_t *cpu = &mii->cpu;
+	uint8_t a = cpu->A, c = 1, v = cpu->P.V, pushed;
+	uint32_t cycles = 1;					// SEC, as the core counts it
+
+	do {
+		pushed = a;
+		cycles += 3;						// PHA
+		if (c && a) {	// no borrow, counts down to zero
+			cycles += a * (2 + 3) - 1;		// SBC, BNE, last one not taken
+			a = v = 0;
+		} else do {
+			a = _hook_sbc1(a, &c, &v);
+			cycles += 2 + (a ? 3 : 2);
+		} while (a && cycles <= budget);
+		a = pushed;
+		cycles += 4;						// PLA
+		a = _hook_sbc1(a, &c, &v);
+		cycles += 2 + (a ? 3 : 2);
+	} while (a && cycles <= budget);
+	cycles += 6;							// RTS
+	if (cycles > budget)
+		return 0;
+	_hook_write(mii, 0x100 | cpu->S, pushed);
+	cpu->A = 0;
+	cpu->P.N = 0;
+	cpu->P.Z = 1;
+	cpu->P.C = c;
+	cpu->P.V = v;
+	_hook_rts(mii);
+	return cycles;
+}
+
+/*
+ * BASCALC ($FBC1), text line base address of line A into BASL/BASH
+ *
+ *	PHA
+ *	LSR
+ *	AND #$03
+ *	ORA #$04
+ *	STA BASH
+ *	PLA
+ *	AND #$18
+ *	BCC *+4
+ *	ADC #$7F
+ *	STA BASL
+ *	ASL
+ *	ASL
+ *	ORA BASL
+ *	STA BASL
+ *	RTS
+ */
+static uint32_t
+_mii_hook_bascalc(
+		mii_t *mii,
+		uint32_t budget)
+{
+	mii_cpu_t *cpu = &mii->cpu;
+	uint8_t a = cpu->A;
+	uint8_t bash = ((a >> 1) & 0x03) | 0x04;
+	uint8_t basl = a & 0x18;
+	// the core counts 4 cycles for STA zp
+	uint32_t cycles = 3 + 2 + 2 + 2 + 4 + 4 + 2 + 3 + 4 + 2 + 2 + 3 + 4 + 6;
+
+	if (a & 1) {	// carry from the LSR, BCC not taken
+		uint16_t sum = basl + 0x7f + 1;
+		cpu->P.V = !!(~(basl ^ 0x7f) & (basl ^ sum) & 0x80);
+		basl = sum;
+		cycles += 2 - 1;
+	}
+	if (cycles > budget)
+		return 0;
+	_hook_write(mii, 0x100 | cpu->S, a);
+	_hook_write(mii, 0x29, bash);
+	_hook_write(mii, 0x28, basl);
+	cpu->P.C = !!(basl & 0x40);
+	cpu->A = (uint8_t)(basl << 2) | basl;
+	_hook_write(mii, 0x28, cpu->A);
+	cpu->P.N = !!(cpu->A & 0x80);
+	cpu->P.Z = cpu->A == 0;
+	_hook_rts(mii);
+	return cycles;
+}
+
+static const uint8_t _mii_wait_code[] = {
+	0x38, 0x48, 0xe9, 0x01, 0xd0, 0xfc, 0x68, 0xe9, 0x01, 0xd0, 0xf6, 0x60,
+};
+static const uint8_t _mii_bascalc_code[] = {
+	0x48, 0x4a, 0x29, 0x03, 0x09, 0x04, 0x85, 0x29, 0x68, 0x29, 0x18, 0x90,
+	0x02, 0x69, 0x7f, 0x85, 0x28, 0x0a, 0x0a, 0x05, 0x28, 0x85, 0x28, 0x60,
+};
+
+static const struct {
+	uint16_t		addr;
+	const char *	name;
+	mii_rom_hook_cb	cb;
+	const uint8_t *	code;	// what the ROM has to contain
+	uint8_t			len;
+} _mii_monitor_hooks[] = {
+	{ 0xfca8, "WAIT", _mii_hook_wait,
+		_mii_wait_code, sizeof(_mii_wait_code) },
+	{ 0xfbc1, "BASCALC", _mii_hook_bascalc,
+		_mii_bascalc_code, sizeof(_mii_bascalc_code) },
+};
+
+void
+mii_rom_hook_install(
+		mii_t *mii)
+{
+	if (!mii->rom_decoded)
+		return;
+	for (unsigned i = 0; i < sizeof(_mii_monitor_hooks) /
+				sizeof(_mii_monitor_hooks[0]); i++) {
+		const mii_cpu_decoded_t *dc =
+				&mii->rom_decoded[_mii_monitor_hooks[i].addr -
+								MII_ROM_DECODED_BASE];
+		int match = 1;
+		for (int b = 0; b < _mii_monitor_hooks[i].len; b++)
+			match &= dc[b].ir == _mii_monitor_hooks[i].code[b];
+		if (!match) {
+			MII_DEBUG_PRINTF("%s: %s not in this ROM\n", __func__,
+					_mii_monitor_hooks[i].name);
+			continue;
+		}
+		mii_rom_hook_register(mii, _mii_monitor_hooks[i].addr,
+				_mii_monitor_hooks[i].name, _mii_monitor_hooks[i].cb);
+	}
+}
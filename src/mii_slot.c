@@ -58,6 +58,7 @@ mii_slot_drv_register(
 		}
 	}
 	mii->slot[slot_id - 1].drv = drv;
+	mii_io_slot_attach(mii, &mii->slot[slot_id - 1]);
 	return 0;
 }
 
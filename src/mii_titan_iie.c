@@ -22,38 +22,36 @@
  * Also, I own one of these, and none of the other fancy ones, so this one
  * gets the love.
  */
-static bool
-_mii_titan_access(
-		struct mii_bank_t *bank,
+// $c086 handler before ours, it's also a language card switch
+static mii_io_t _mii_titan_prev;
+
+static void
+_mii_titan_write(
+		mii_t *mii,
 		void *param,
 		uint16_t addr,
-		uint8_t * byte,
-		bool write)
+		uint8_t byte)
 {
-	mii_t *mii = param;
-	bool res = false;
 	mii_bank_t *sw = &mii->bank[MII_BANK_SW];
-	if (write) {
-		MII_DEBUG_PRINTF("titan: write %02x to %04x\n", *byte, addr);
-		switch (*byte) {
-			case 5:
-				mii->speed = MII_SPEED_TITAN;
-				mii_bank_poke(sw, 0xc086, *byte);
-			 	break;
-			case 1:
-				mii_bank_poke(sw, 0xc086, *byte);
-				mii->speed = MII_SPEED_NTSC;
-				break;
-			case 0xa:	// supposed to lock it too...
-				mii_bank_poke(sw, 0xc086, *byte);
-				mii->speed = MII_SPEED_NTSC;
-				break;
-			default:
-				MII_DEBUG_PRINTF("titan: unknown speed %02x\n", *byte);
-				break;
-		}
+	MII_DEBUG_PRINTF("titan: write %02x to %04x\n", byte, addr);
+	switch (byte) {
+		case 5:
+			mii->speed = MII_SPEED_TITAN;
+			mii_bank_poke(sw, 0xc086, byte);
+		 	break;
+		case 1:
+			mii_bank_poke(sw, 0xc086, byte);
+			mii->speed = MII_SPEED_NTSC;
+			break;
+		case 0xa:	// supposed to lock it too...
+			mii_bank_poke(sw, 0xc086, byte);
+			mii->speed = MII_SPEED_NTSC;
+			break;
+		default:
+			MII_DEBUG_PRINTF("titan: unknown speed %02x\n", byte);
+			break;
 	}
-	return res;
+	_mii_titan_prev.write(mii, _mii_titan_prev.write_param, addr, byte);
 }
 
 static int
@@ -66,7 +64,8 @@ _mii_titan_probe(
 		return 0;
 	// this override a read-only soft switch, but we only handle writes
 	// so it's fine
-	mii_set_sw_override(mii, 0xc086, _mii_titan_access, mii);
+	_mii_titan_prev = mii->io[0x86];
+	mii_set_sw_override(mii, 0xc086, NULL, _mii_titan_write, mii);
 	mii->speed = 3.58;
 	return 1;
 }
@@ -595,12 +595,16 @@ _mii_line_render_lores(
 #endif // !MII_RP2350 - end of desktop render functions
 
 #if MII_RP2350
-// RP2350 stubs for callback-based rendering system (we use our own direct render)
+/*
+ * RP2350 stubs for callback-based rendering system (we use our own direct
+ * render). It finds the changed lines from the page write generations, and
+ * compares the mode by itself, 'frame_dirty' is bumped to force a full redraw.
+ */
 static void
 _mii_video_mark_dirty(
 		mii_video_t *video)
 {
-	video->frame_dirty = 1;
+	(void)video;
 }
 
 static void
@@ -608,19 +612,79 @@ _mii_video_mode_changed(
 		mii_video_t *video,
 		uint32_t sw_state)
 {
+	(void)video;
 	(void)sw_state;
-	video->frame_dirty = 1;
 }
 
+// Forward declarations, the tables are with the renderer
+static void _mii_hgr_lut_init(void);
+static void _mii_text_lut_init(void);
+
+// The switches that change what is on screen
+#define MII_VIDEO_SW_MASK \
+		(M_SW80STORE | M_SWALTCHARSET | M_SW80COL | M_SWTEXT | \
+			M_SWMIXED | M_SWPAGE2 | M_SWHIRES | M_SWDHIRES)
+
+#if MII_VIDEO_MODE_LOG
+/*
+ * Log the video switches if they changed. Changes in the vertical blank
+ * just become the mode the next frame starts with.
+ */
+static void
+_mii_video_log_mode(
+		mii_t *mii)
+{
+	mii_video_t *video = &mii->video;
+	uint32_t sw = mii->sw_state & MII_VIDEO_SW_MASK;
+
+	if (likely(sw == video->mode_log_sw))
+		return;
+	video->mode_log_sw = sw;
+	mii_video_mode_log_t *log = &video->mode_log[video->mode_log_seq & 1];
+	uint64_t now = mii->cpu.total_cycle + mii->cpu.cycle;
+	if (now <= log->start)
+		log->sw = sw;
+	else if (log->count < MII_VIDEO_MODE_LOG) {
+		log->e[log->count].cycle = now - log->start;
+		log->e[log->count].sw = sw;
+		log->count++;
+	} else
+		log->count = MII_VIDEO_MODE_LOG + 1;
+}
+
+/*
+ * Called as the vertical blank starts, 'vbl' being the exact cycle. Hands
+ * the log of the frame that just ended to the renderer, and starts the one
+ * of the next frame.
+ */
+static void
+_mii_video_log_frame(
+		mii_t *mii,
+		uint64_t vbl)
+{
+	mii_video_t *video = &mii->video;
+	uint32_t seq = video->mode_log_seq + 1;
+	mii_video_mode_log_t *log = &video->mode_log[seq & 1];
+
+	// the renderer checks the sequence after copying the log
+	__atomic_store_n(&video->mode_log_seq, seq, __ATOMIC_RELEASE);
+	log->start = vbl + (uint64_t)(MII_VBL_UP_CYCLES * mii->speed);
+	log->line_cycles = (MII_VIDEO_H_CYCLES + MII_VIDEO_HB_CYCLES) * mii->speed;
+	log->sw = video->mode_log_sw;
+	log->count = 0;
+}
+#endif
+
 void
 mii_video_OOB_write_check(
 		mii_t *mii,
 		uint16_t addr,
 		uint16_t size)
 {
+	// mii_bank_write() bumps the page generations, nothing to do
+	(void)mii;
 	(void)addr;
 	(void)size;
-	mii->video.frame_dirty = 1;
 }
 
 /*
@@ -651,6 +715,10 @@ mii_video_vbl_timer_cb(
 		mii_bank_poke(sw, SWVBL, 0x80);
 		video->vbl_phase = 1;
 		video->frame_count++;
+#if MII_VIDEO_MODE_LOG
+		_mii_video_log_frame(mii,
+				mii->timer.last_run + mii_timer_get(mii, video->timer_id));
+#endif
 		return (uint64_t)(MII_VBL_UP_CYCLES * mii->speed);
 	} else {
 		// End of vblank, starting visible area - CLEAR bit 7
@@ -675,11 +743,11 @@ mii_video_reset_vbl_timer(mii_t *mii)
 	video->vbl_phase = 0;
 	mii_bank_poke(sw, SWVBL, 0x00);
 	
+	// Reset last_run to current cycle count, timers are armed relative to it
+	mii->timer.last_run = mii->cpu.total_cycle + mii->cpu.cycle;
+	
 	// Set timer to a positive value - must be > 0 for timer to run
 	mii_timer_set(mii, video->timer_id, MII_VBL_DOWN_CYCLES);
-	
-	// Reset last_run to current cycle count
-	mii->timer.last_run = mii->cpu.total_cycle + mii->cpu.cycle;
 }
 
 #else // !MII_RP2350
@@ -945,9 +1013,6 @@ mii_access_video(
 #if !MII_RP2350
 	if (write)
 		mii->video.line_cb.check(&mii->video, mii->sw_state, addr);
-#else
-	if (write)
-		mii->video.frame_dirty = 1;
 #endif
 	mii_bank_t * sw = &mii->bank[MII_BANK_SW];
 	switch (addr) {
@@ -1052,6 +1117,9 @@ mii_access_video(
 				*byte = mii_video_get_vapor(mii);
 			break;
 	}
+#if MII_RP2350 && MII_VIDEO_MODE_LOG
+	_mii_video_log_mode(mii);
+#endif
 	return res;
 }
 
@@ -1084,7 +1152,7 @@ void
 mii_video_full_refresh(
 		mii_t *mii)
 {
-	mii->video.frame_dirty = 1;
+	mii->video.frame_dirty++;
 }
 #endif // MII_RP2350
 
@@ -1102,6 +1170,14 @@ mii_video_init(
 	mii->video.timer_id = mii_timer_register(mii,
 				mii_video_vbl_timer_cb, NULL, MII_VBL_DOWN_CYCLES, "vbl_timer");
 	MII_DEBUG_PRINTF("VBL timer registered (id=%d)\n", mii->video.timer_id);
+	if (MII_VIDEO_HGR_LUT)
+		_mii_hgr_lut_init();
+	if (MII_VIDEO_GLYPH_CACHE)
+		_mii_text_lut_init();
+#if MII_VIDEO_MODE_LOG
+	video->mode_log_sw = mii->sw_state & MII_VIDEO_SW_MASK;
+	video->mode_log[0].sw = video->mode_log[1].sw = video->mode_log_sw;
+#endif
 #else
 	mii->video.timer_id = mii_timer_register(mii,
 				mii_video_timer_cb, NULL, MII_VIDEO_H_CYCLES, __func__);
@@ -1464,12 +1540,148 @@ static const uint8_t rp2350_ci_to_hw[16] = {
 	[CI_AQUA] = 14,
 };
 
-// Render text mode (40 column) to framebuffer - OPTIMIZED
+// A line of the 192 Apple II lines is set in a dirty bitmap
+#define _MII_LINE_DIRTY(_d, _l) 	(((_d)[(_l) >> 6] >> ((_l) & 63)) & 1)
+
+// Glyph shown for character 'c', flashing ones alternate normal and inverse
+static inline uint8_t
+_mii_text_char(
+		uint8_t c,
+		int flash)
+{
+	if (flash && c >= 0x40 && c <= 0x7F)
+		c = (int)c + flash;
+	return c;
+}
+
+// Pixels of a glyph line in 40 columns: 7, and 1 of padding
+static inline void
+_mii_text_pixels40(
+		uint8_t bits,
+		uint8_t *fb_ptr)
+{
+	fb_ptr[0] = (bits & 0x01) ? 0 : 15;
+	fb_ptr[1] = (bits & 0x02) ? 0 : 15;
+	fb_ptr[2] = (bits & 0x04) ? 0 : 15;
+	fb_ptr[3] = (bits & 0x08) ? 0 : 15;
+	fb_ptr[4] = (bits & 0x10) ? 0 : 15;
+	fb_ptr[5] = (bits & 0x20) ? 0 : 15;
+	fb_ptr[6] = (bits & 0x40) ? 0 : 15;
+	fb_ptr[7] = 0;  // 8th pixel padding
+}
+
+// Pixels of a glyph line in 80 columns, pairs of pixels ORed into one
+static inline void
+_mii_text_pixels80(
+		uint8_t bits,
+		uint8_t *fb_ptr)
+{
+	for (int px = 0; px < 4; px++) {
+		int bit0 = px * 2;
+		bool pixel = ((bits >> bit0) & 1) | ((bits >> (bit0 + 1)) & 1);
+		fb_ptr[px] = pixel ? 0 : 15;
+	}
+}
+
+/*
+ * Decode glyph line 'cy' of a text row into 320 pixels, bit by bit; 40
+ * columns from 'main', or 80 alternating with 'aux'. 'flash' is 0 with
+ * ALTCHARSET on.
+ */
+static void
+_mii_text_line_pixels(
+		const uint8_t *main_mem,
+		const uint8_t *aux_mem,
+		const uint8_t *rom_base,
+		int cy,
+		int flash,
+		uint8_t *fb_ptr)
+{
+	if (!aux_mem) {
+		for (int x = 0; x < 40; x++, fb_ptr += 8) {
+			uint8_t c = _mii_text_char(main_mem[x], flash);
+			_mii_text_pixels40(rom_base[(c << 3) + cy], fb_ptr);
+		}
+		return;
+	}
+	for (int x = 0; x < 80; x++, fb_ptr += 4) {
+		uint8_t c = (x & 1) ? main_mem[x >> 1] : aux_mem[x >> 1];
+		c = _mii_text_char(c, flash);
+		_mii_text_pixels80(rom_base[(c << 3) + cy], fb_ptr);
+	}
+}
+
+/*
+ * Pixels of a glyph line, for each of the 256 ROM bit patterns, first one
+ * in the low byte: 8 for 40 columns, 4 for 80.
+ */
+static uint32_t _mii_text_row40[256][2];
+static uint32_t _mii_text_row80[256];
+
+static void
+_mii_text_lut_init(void)
+{
+	for (int bits = 0; bits < 256; bits++) {
+		uint8_t p[8];
+		_mii_text_pixels40(bits, p);
+		memcpy(_mii_text_row40[bits], p, 8);
+		_mii_text_pixels80(bits, p);
+		memcpy(&_mii_text_row80[bits], p, 4);
+	}
+}
+
+/*
+ * The glyphs of the current ROM bank, copied out of flash. ALTCHARSET and
+ * the flash phase only change which of them a character shows, so this is
+ * only rebuilt when the ROM or its bank changes.
+ */
+static const uint8_t (*
+_mii_video_glyphs(
+		mii_video_t *video,
+		const uint8_t *rom_base))[8]
+{
+	if (video->glyph_rom != rom_base) {
+		memcpy(video->glyph, rom_base, sizeof(video->glyph));
+		video->glyph_rom = rom_base;
+	}
+	return (const uint8_t (*)[8])video->glyph;
+}
+
+// Same as _mii_text_line_pixels() from the glyph cache, a word at a time
+static void
+_mii_text_line_glyphs(
+		const uint8_t *main_mem,
+		const uint8_t *aux_mem,
+		const uint8_t (*glyph)[8],
+		int cy,
+		int flash,
+		uint8_t *fb_ptr)
+{
+	uint32_t *w = (uint32_t *)fb_ptr;
+
+	if (!aux_mem) {
+		for (int x = 0; x < 40; x++, w += 2) {
+			const uint32_t *row =
+					_mii_text_row40[glyph[_mii_text_char(main_mem[x], flash)][cy]];
+			w[0] = row[0];
+			w[1] = row[1];
+		}
+		return;
+	}
+	for (int x = 0; x < 40; x++, w += 2) {
+		w[0] = _mii_text_row80[glyph[_mii_text_char(aux_mem[x], flash)][cy]];
+		w[1] = _mii_text_row80[glyph[_mii_text_char(main_mem[x], flash)][cy]];
+	}
+}
+
+// Render the text lines set in 'dirty', 40 or 80 columns
 static void __attribute__((hot))
-mii_video_render_text40_rp2350(
+mii_video_render_text_rp2350(
 		mii_t *mii,
 		uint8_t *fb,
-		int fb_width)
+		int fb_width,
+		uint32_t sw,
+		const uint64_t *dirty)
 {
 	mii_bank_t *main_bank = &mii->bank[MII_BANK_MAIN];
 	mii_bank_t *aux_bank = &mii->bank[MII_VIDEO_BANK];
@@ -1479,7 +1691,6 @@ mii_video_render_text40_rp2350(
 	if (!char_rom) {
 		return;
 	}
-	uint32_t sw = mii->sw_state;
 	bool page2 = SWW_GETSTATE(sw, SW80STORE) ? 0 : SWW_GETSTATE(sw, SWPAGE2);
 	uint16_t base_addr = 0x400 + (0x400 * page2);
 	bool col80 = SWW_GETSTATE(sw, SW80COL);
@@ -1487,184 +1698,196 @@ mii_video_render_text40_rp2350(
 	const uint8_t *rom_base = char_rom;
 	if (video->rom && video->rom->len > (4 * 1024) && video->rom_bank)
 		rom_base += (4 * 1024);
+	const uint8_t (*glyph)[8] = MII_VIDEO_GLYPH_CACHE ?
+			_mii_video_glyphs(video, rom_base) : NULL;
 	
 	// Direct memory pointers for speed
 	uint8_t *main_mem = main_bank->mem;
 	uint8_t *aux_mem = aux_bank->mem;
-	int flash = (video->frame_count & 0x10) ? -0x40 : 0x40;
+	int flash = altset ? 0 : (video->frame_count & 0x10) ? -0x40 : 0x40;
 	
 	// Text screen is 40x24 (or 80x24 if SW80COL is on)
 	// Render at 192 lines and vertically center (24 pixel offset)
 	
-	for (int row = 0; row < 24; row++) {
+	for (int line = 0; line < 192; line++) {
+		if (!_MII_LINE_DIRTY(dirty, line))
+			continue;
+		int row = line >> 3;
 		// Apple II text memory is interleaved
 		uint16_t line_addr = base_addr + (row & 7) * 0x80 + (row / 8) * 0x28;
+		uint8_t *fb_ptr = fb + (24 + line) * fb_width;
+		const uint8_t *aux = col80 ? aux_mem + line_addr : NULL;
+		video->lines_drawn++;
 
-		if (!col80) {
-			// 40-column mode - most common case, highly optimized
-			for (int x = 0; x < 40; x++) {
-				uint8_t c = main_mem[line_addr + x];
-
-				// Flash handling
-				if (!altset && c >= 0x40 && c <= 0x7F)
-					c = (int)c + flash;
-
-				const uint8_t *char_data = rom_base + (c << 3);
-				int fb_x_base = x * 8;
-				uint8_t *fb_row_base = fb + 24 * fb_width + row * 8 * fb_width + fb_x_base;
-
-				for (int cy = 0; cy < 8; cy++) {
-					uint8_t bits = char_data[cy];
-					uint8_t *fb_ptr = fb_row_base + cy * fb_width;
-					// Unrolled inner loop for 7 pixels + 1 padding
-					fb_ptr[0] = (bits & 0x01) ? 0 : 15;
-					fb_ptr[1] = (bits & 0x02) ? 0 : 15;
-					fb_ptr[2] = (bits & 0x04) ? 0 : 15;
-					fb_ptr[3] = (bits & 0x08) ? 0 : 15;
-					fb_ptr[4] = (bits & 0x10) ? 0 : 15;
-					fb_ptr[5] = (bits & 0x20) ? 0 : 15;
-					fb_ptr[6] = (bits & 0x40) ? 0 : 15;
-					fb_ptr[7] = 0;  // 8th pixel padding
-				}
-			}
+		if (MII_VIDEO_GLYPH_CACHE)
+			_mii_text_line_glyphs(main_mem + line_addr, aux, glyph,
+					line & 7, flash, fb_ptr);
+		else
+			_mii_text_line_pixels(main_mem + line_addr, aux, rom_base,
+					line & 7, flash, fb_ptr);
+	}
+}
+
+/*
+ * Palette index of HGR pixel 'i' (0-6) of a byte, 'run' holding the last 2
+ * bits of the previous byte, the 7 of this one and the first 2 of the next.
+ * Same artifact colours as the desktop renderer (_mii_line_render_hires).
+ */
+static inline uint8_t
+_mii_hgr_pixel(
+		uint16_t run,
+		int i,
+		int odd,
+		int offset,
+		bool mono)
+{
+	uint8_t left = (run >> (1 + i)) & 1;
+	uint8_t pixel = (run >> (2 + i)) & 1;
+	uint8_t right = (run >> (3 + i)) & 1;
+	if (mono)
+		return pixel ? 15 : 0;
+	int idx = 0; // black
+	if (pixel) {
+		if (left || right) {
+			idx = 9; // white
 		} else {
-			// 80-column mode
-			for (int x = 0; x < 80; x++) {
-				uint8_t c;
-				if (x & 1)
-					c = main_mem[line_addr + (x >> 1)];
-				else
-					c = aux_mem[line_addr + (x >> 1)];
-
-				if (!altset && c >= 0x40 && c <= 0x7F)
-					c = (int)c + flash;
-
-				const uint8_t *char_data = rom_base + (c << 3);
-
-				for (int cy = 0; cy < 8; cy++) {
-					uint8_t bits = char_data[cy];
-					int fb_y = 24 + row * 8 + cy;
-					if (fb_y >= 240)
-						continue;
-					int fb_x_base = x * 4;
-					uint8_t *fb_ptr = fb + fb_y * fb_width + fb_x_base;
-					for (int px = 0; px < 4 && fb_x_base + px < fb_width; px++) {
-						int bit0 = px * 2;
-						bool pixel = ((bits >> bit0) & 1) | ((bits >> (bit0 + 1)) & 1);
-						fb_ptr[px] = pixel ? 0 : 15;
-					}
-				}
-			}
+			idx = offset + odd + (i & 1) + 1;
+		}
+	} else {
+		if (left && right) {
+			idx = offset + odd + 1 - (i & 1) + 1;
 		}
 	}
+	uint8_t ci = (uint8_t)mii_base_clut.hires[idx];
+	return rp2350_ci_to_hw[ci & 0x0f];
 }
 
-// Render bottom 4 text lines for mixed mode (lines 160-191 in Apple II coords) - OPTIMIZED
-static void __attribute__((hot))
-mii_video_render_text40_mixed_rp2350(
-		mii_t *mii,
-		uint8_t *fb,
-		int fb_width)
+// Decode the 40 bytes of an HGR line into 280 pixels, one at a time
+static void
+_mii_hgr_line_pixels(
+		const uint8_t *src,
+		uint8_t *out,
+		bool mono)
 {
-	mii_bank_t *main_bank = &mii->bank[MII_BANK_MAIN];
-	mii_bank_t *aux_bank = &mii->bank[MII_VIDEO_BANK];
-	mii_video_t *video = &mii->video;
-	const uint8_t *char_rom = video->rom ? video->rom->rom : NULL;
-	
-	if (!char_rom) return;
-	uint32_t sw = mii->sw_state;
-	bool page2 = SWW_GETSTATE(sw, SW80STORE) ? 0 : SWW_GETSTATE(sw, SWPAGE2);
-	uint16_t base_addr = 0x400 + (0x400 * page2);
-	bool col80 = SWW_GETSTATE(sw, SW80COL);
-	bool altset = SWW_GETSTATE(sw, SWALTCHARSET);
-	const uint8_t *rom_base = char_rom;
-	if (video->rom && video->rom->len > (4 * 1024) && video->rom_bank)
-		rom_base += (4 * 1024);
-	
-	// Direct memory pointers for speed
-	uint8_t *main_mem = main_bank->mem;
-	uint8_t *aux_mem = aux_bank->mem;
-	int flash = (video->frame_count & 0x10) ? -0x40 : 0x40;
-	
-	// In mixed mode, only render the bottom 4 text rows (rows 20-23)
-	// These correspond to Apple II lines 160-191
-	for (int row = 20; row < 24; row++) {
-		uint16_t line_addr = base_addr + (row & 7) * 0x80 + (row / 8) * 0x28;
+	uint8_t b0 = 0;
+	uint8_t b1 = src[0];
+	for (int col = 0; col < 40; col++) {
+		uint8_t b2 = (col == 39) ? 0 : src[col + 1];
+		// last 2 pixels, current 7 pixels, next 2 pixels
+		uint16_t run = ((b0 & 0x60) >> 5) |
+					((b1 & 0x7f) << 2) |
+					((b2 & 0x03) << 9);
+		int odd = (col & 1) << 1;
+		int offset = (b1 & 0x80) >> 5; // 0 or 4
+
+		for (int i = 0; i < 7; i++)
+			*out++ = _mii_hgr_pixel(run, i, odd, offset, mono);
+		b0 = b1;
+		b1 = b2;
+	}
+}
 
-		if (!col80) {
-			for (int x = 0; x < 40; x++) {
-				uint8_t c = main_mem[line_addr + x];
-
-				if (!altset && c >= 0x40 && c <= 0x7F)
-					c = (int)c + flash;
-
-				const uint8_t *char_data = rom_base + (c << 3);
-				int fb_x_base = x * 8;
-				uint8_t *fb_row_base = fb + 24 * fb_width + row * 8 * fb_width + fb_x_base;
-
-				for (int cy = 0; cy < 8; cy++) {
-					uint8_t bits = char_data[cy];
-					uint8_t *fb_ptr = fb_row_base + cy * fb_width;
-					fb_ptr[0] = (bits & 0x01) ? 0 : 15;
-					fb_ptr[1] = (bits & 0x02) ? 0 : 15;
-					fb_ptr[2] = (bits & 0x04) ? 0 : 15;
-					fb_ptr[3] = (bits & 0x08) ? 0 : 15;
-					fb_ptr[4] = (bits & 0x10) ? 0 : 15;
-					fb_ptr[5] = (bits & 0x20) ? 0 : 15;
-					fb_ptr[6] = (bits & 0x40) ? 0 : 15;
-					fb_ptr[7] = 0;
-				}
-			}
-		} else {
-			for (int x = 0; x < 80; x++) {
-				uint8_t c = (x & 1) ? main_mem[line_addr + (x >> 1)]
-				                   : aux_mem[line_addr + (x >> 1)];
-
-				if (!altset && c >= 0x40 && c <= 0x7F)
-					c = (int)c + flash;
-
-				const uint8_t *char_data = rom_base + (c << 3);
-				for (int cy = 0; cy < 8; cy++) {
-					uint8_t bits = char_data[cy];
-					int fb_y = 24 + row * 8 + cy;
-					if (fb_y >= 240) continue;
-					int fb_x_base = x * 4;
-					uint8_t *fb_ptr = fb + fb_y * fb_width + fb_x_base;
-					for (int px = 0; px < 4 && fb_x_base + px < fb_width; px++) {
-						int bit0 = px * 2;
-						bool pixel = ((bits >> bit0) & 1) | ((bits >> (bit0 + 1)) & 1);
-						fb_ptr[px] = pixel ? 0 : 15;
-					}
-				}
-			}
+/*
+ * The 7 pixels of an HGR byte for each context, first one in the low byte.
+ * Only the last bit of the previous byte and the first bit of the next one
+ * change the colours, the index is:
+ *   odd column << 10 | palette bit << 9 | next << 8 | data << 1 | previous
+ * The mono pixels only depend on the 7 data bits. 17KB, in SRAM.
+ */
+static uint64_t _mii_hgr_color[2048];
+static uint64_t _mii_hgr_mono[128];
+
+static void
+_mii_hgr_lut_init(void)
+{
+	for (int idx = 0; idx < 2048; idx++) {
+		uint16_t run = ((idx & 1) << 1) | ((idx & 0x1fe) << 1);
+		int offset = (idx >> 9 & 1) << 2;
+		int odd = (idx >> 10 & 1) << 1;
+		uint64_t e = 0;
+		for (int i = 0; i < 7; i++)
+			e |= (uint64_t)_mii_hgr_pixel(run, i, odd, offset, false) << (i * 8);
+		_mii_hgr_color[idx] = e;
+	}
+	for (int idx = 0; idx < 128; idx++) {
+		uint64_t e = 0;
+		for (int i = 0; i < 7; i++)
+			e |= (uint64_t)_mii_hgr_pixel(idx << 2, i, 0, 0, true) << (i * 8);
+		_mii_hgr_mono[idx] = e;
+	}
+}
+
+// 4 bytes make 28 pixels, stored as 7 words
+static inline void
+_mii_hgr_store4(
+		uint32_t *out,
+		const uint64_t *e)
+{
+	out[0] = e[0];
+	out[1] = (e[0] >> 32) | (e[1] << 24);
+	out[2] = e[1] >> 8;
+	out[3] = (e[1] >> 40) | (e[2] << 16);
+	out[4] = e[2] >> 16;
+	out[5] = (e[2] >> 48) | (e[3] << 8);
+	out[6] = e[3] >> 24;
+}
+
+// Same as _mii_hgr_line_pixels() from the tables, 'out' has to be aligned
+static void
+_mii_hgr_line_lut(
+		const uint8_t *src,
+		uint8_t *out,
+		bool mono)
+{
+	uint32_t *w = (uint32_t *)out;
+	uint64_t e[4];
+
+	if (mono) {
+		for (int col = 0; col < 40; col += 4, w += 7) {
+			for (int k = 0; k < 4; k++)
+				e[k] = _mii_hgr_mono[src[col + k] & 0x7f];
+			_mii_hgr_store4(w, e);
+		}
+		return;
+	}
+	uint32_t prev = 0;
+	for (int col = 0; col < 40; col += 4, w += 7) {
+		for (int k = 0; k < 4; k++) {
+			uint32_t b = src[col + k];
+			uint32_t next = col + k < 39 ? src[col + k + 1] & 1 : 0;
+			e[k] = _mii_hgr_color[((k & 1) << 10) | ((b & 0x80) << 2) |
+						(next << 8) | ((b & 0x7f) << 1) | prev];
+			prev = (b >> 6) & 1;
 		}
+		_mii_hgr_store4(w, e);
 	}
 }
 
-// Render hi-res graphics to framebuffer - OPTIMIZED
+// Render hi-res graphics to framebuffer
 static void __attribute__((hot))
 mii_video_render_hires_rp2350(
 		mii_t *mii,
 		uint8_t *fb,
-		int fb_width)
+		int fb_width,
+		uint32_t sw,
+		const uint64_t *dirty)
 {
 	mii_bank_t *main_bank = &mii->bank[MII_BANK_MAIN];
 	uint8_t *mem = main_bank->mem;  // Direct memory access
 	mii_video_t *video = &mii->video;
 	const uint8_t HW_BLACK = 0;
-	const uint8_t HW_WHITE = 15;
 	
 	// Check PAGE2 switch to select which HGR page
-	uint32_t sw = mii->sw_state;
 	bool page2 = SWW_GETSTATE(sw, SW80STORE) ? 0 : SWW_GETSTATE(sw, SWPAGE2);
 	uint16_t base_addr = page2 ? 0x4000 : 0x2000;
 	
 	// HGR is 280x192. Render 1:1 into a 320-wide buffer with 20px borders.
-	// Use the same artifact-color decoding as the desktop renderer (_mii_line_render_hires).
 	const int x_off = (320 - 280) / 2; // 20
 	const bool mono = video->monochrome;
 	
 	for (int line = 0; line < 192; line++) {
+		if (!_MII_LINE_DIRTY(dirty, line))
+			continue;
 		// Apple II HGR line address calculation (same as original)
 		// Use the same formula as _mii_line_to_video_addr
 		uint16_t line_addr = base_addr + 
@@ -1673,52 +1896,16 @@ mii_video_render_hires_rp2350(
 			((line >> 6) * 40);          // (line / 64) * 40
 		
 		int fb_y = 24 + line;  // 24 pixel vertical offset to center
-		if (fb_y >= 240) continue;
 		
 		uint8_t *fb_row = fb + fb_y * fb_width;
-		// Clear the whole row to black so borders don't retain stale pixels.
-		memset(fb_row, HW_BLACK, (size_t)fb_width);
-
-		uint8_t b0 = 0;
-		uint8_t b1 = mem[line_addr + 0];
-		for (int col = 0; col < 40; col++) {
-			uint8_t b2 = (col == 39) ? 0 : mem[line_addr + col + 1];
-			// last 2 pixels, current 7 pixels, next 2 pixels
-			uint16_t run = ((b0 & 0x60) >> 5) |
-						((b1 & 0x7f) << 2) |
-						((b2 & 0x03) << 9);
-			int odd = (col & 1) << 1;
-			int offset = (b1 & 0x80) >> 5; // 0 or 4
-
-			for (int i = 0; i < 7; i++) {
-				uint8_t left = (run >> (1 + i)) & 1;
-				uint8_t pixel = (run >> (2 + i)) & 1;
-				uint8_t right = (run >> (3 + i)) & 1;
-				int idx = 0; // black
-				if (!mono) {
-					if (pixel) {
-						if (left || right) {
-							idx = 9; // white
-						} else {
-							idx = offset + odd + (i & 1) + 1;
-						}
-					} else {
-						if (left && right) {
-							idx = offset + odd + 1 - (i & 1) + 1;
-						}
-					}
-					uint8_t ci = (uint8_t)mii_base_clut.hires[idx];
-					uint8_t hw = rp2350_ci_to_hw[ci & 0x0f];
-					int x = col * 7 + i;
-					fb_row[x_off + x] = hw;
-				} else {
-					int x = col * 7 + i;
-					fb_row[x_off + x] = pixel ? HW_WHITE : HW_BLACK;
-				}
-			}
-			b0 = b1;
-			b1 = b2;
-		}
+		// Clear the side borders so they don't retain stale pixels.
+		memset(fb_row, HW_BLACK, x_off);
+		memset(fb_row + x_off + 280, HW_BLACK, 320 - x_off - 280);
+		video->lines_drawn++;
+		if (MII_VIDEO_HGR_LUT)
+			_mii_hgr_line_lut(mem + line_addr, fb_row + x_off, mono);
+		else
+			_mii_hgr_line_pixels(mem + line_addr, fb_row + x_off, mono);
 	}
 }
 
@@ -1736,11 +1923,12 @@ static void __attribute__((hot))
 mii_video_render_dhires_rp2350(
 		mii_t *mii,
 		uint8_t *fb,
-		int fb_width)
+		int fb_width,
+		uint32_t sw,
+		const uint64_t *dirty)
 {
 	mii_bank_t *main_bank = &mii->bank[MII_BANK_MAIN];
 	mii_bank_t *aux_bank = &mii->bank[MII_VIDEO_BANK];
-	const uint32_t sw = mii->sw_state;
 	const bool page2 = SWW_GETSTATE(sw, SW80STORE) ? 0 : SWW_GETSTATE(sw, SWPAGE2);
 	uint16_t base_addr = 0x2000 + (0x2000 * page2);
 
@@ -1753,11 +1941,12 @@ mii_video_render_dhires_rp2350(
 	const bool color = (mii->video.an3_mode != 0) && !mii->video.monochrome;
 
 	for (int line = 0; line < 192; line++) {
+		if (!_MII_LINE_DIRTY(dirty, line))
+			continue;
 		uint16_t line_addr = _mii_line_to_video_addr(base_addr, (uint8_t)line);
 		int fb_y = 24 + line;
-		if (fb_y >= 240)
-			continue;
 		uint8_t *fb_row = fb + fb_y * fb_width;
+		mii->video.lines_drawn++;
 
 		if (!color) {
 			// Mono: combine MAIN/AUX 7-bit streams into 14-bit pixels (560 wide)
@@ -1812,7 +2001,9 @@ static void __attribute__((hot))
 mii_video_render_lores_rp2350(
 		mii_t *mii,
 		uint8_t *fb,
-		int fb_width)
+		int fb_width,
+		uint32_t sw,
+		const uint64_t *dirty)
 {
 	mii_bank_t *main_bank = &mii->bank[MII_BANK_MAIN];
 	
@@ -1825,13 +2016,18 @@ mii_video_render_lores_rp2350(
 	// We scale to 320x240: 8 pixels wide x 5 scanlines tall
 	
 	// Check PAGE2 switch - Page 1 at $400, Page 2 at $800
-	bool page2 = !!(mii->sw_state & M_SWPAGE2);
+	bool page2 = !!(sw & M_SWPAGE2);
 	uint16_t base_addr = page2 ? 0x800 : 0x400;
 	
 	// Direct memory access for speed
 	uint8_t *mem = main_bank->mem;
 	
 	for (int lores_row = 0; lores_row < 48; lores_row++) {
+		// a block covers 4 Apple II lines, redraw it if any is dirty
+		int line = lores_row * 4;
+		if (!((dirty[line >> 6] >> (line & 63)) & 0xf))
+			continue;
+		mii->video.lines_drawn += 4;
 		// Convert LORES row (0-47) to memory row (0-23) 
 		int mem_row = lores_row / 2;
 		int is_bottom_half = lores_row & 1;
@@ -1871,16 +2067,17 @@ mii_video_render(
 // Forward declaration
 int mii_disk2_get_motor_state(void);
 
-// Draw a simple floppy disk activity indicator in the bottom border
-static void
-mii_video_draw_floppy_indicator(uint8_t *hdmi_buffer, int motor_state, uint32_t frame_count)
+// Draw row 'y' of a simple floppy disk activity indicator in the bottom
+// border into 'row', returns true if it was drawn
+static bool
+mii_video_draw_floppy_row(uint8_t *row, int y, int motor_state, uint32_t frame_count)
 {
 	if (motor_state == 0)
-		return;  // No motor active, don't draw
+		return false;  // No motor active, don't draw
 	
 	// Flash the icon (on/off every 8 frames, approx 130ms at 60Hz) to indicate activity
 	if ((frame_count / 8) % 2 == 0) {
-		return; 
+		return false;
 	}
 	
 	// Draw in bottom-right corner of bottom border
@@ -1903,74 +2100,399 @@ mii_video_draw_floppy_indicator(uint8_t *hdmi_buffer, int motor_state, uint32_t
 		0b1001111001, // #..####..#
 		0b0111111110, // .########.
 	};
+	if (y < start_y || y >= start_y + 10)
+		return true;
 	
 	// Color: Green for drive 1, Red/Orange for drive 2
 	uint8_t body_color = (motor_state == 1) ? 0x1C : 0xE0;  
 	
-	for (int y = 0; y < 10; y++) {
-		uint16_t row = floppy_icon[y];
-		for (int x = 0; x < 10; x++) {
-			if (row & (1 << (9 - x))) {
-				int offset = (start_y + y) * 320 + (start_x + x);
-				// Solid color
-				hdmi_buffer[offset] = body_color;
-			}
+	uint16_t bits = floppy_icon[y - start_y];
+	for (int x = 0; x < 10; x++) {
+		if (bits & (1 << (9 - x))) {
+			// Solid color
+			row[start_x + x] = body_color;
 		}
 	}
+	return true;
 }
 
-// Scale Apple II video to HDMI framebuffer
-void
-mii_video_scale_to_hdmi(
-		mii_video_t *video,
-		uint8_t *hdmi_buffer)
+// Draw the floppy indicator over a whole buffer, returns true if it was drawn
+static bool
+mii_video_draw_floppy_indicator(uint8_t *hdmi_buffer, int motor_state, uint32_t frame_count)
+{
+	bool drawn = false;
+	for (int y = 222; y < 222 + 10; y++)
+		drawn = mii_video_draw_floppy_row(hdmi_buffer + y * 320, y,
+					motor_state, frame_count);
+	return drawn;
+}
+
+#if MII_VIDEO_DIRTY_LINES && MII_65C02_WRITE_GEN
+/*
+ * Set the lines showing the VRAM pages set in 'changed' (bit 0 is page $04)
+ * into 'lines', for the mode in 'sw'. Text pages only count where text or
+ * lores is on screen, and HGR pages where hires is.
+ */
+static void
+_mii_video_pages_to_lines(
+		uint32_t sw,
+		const uint32_t *changed,
+		uint64_t *lines)
 {
-	// Get parent mii structure
-	mii_t *mii = (mii_t *)((char*)video - offsetof(mii_t, video));
-	
-	// Clear top and bottom borders (24 rows each) to black
-	// Top border: rows 0-23
-	memset(hdmi_buffer, 0, 320 * 24);
-	// Bottom border: rows 216-239
-	memset(hdmi_buffer + 320 * 216, 0, 320 * 24);
-	
-	uint32_t sw = mii->sw_state;
 	bool text_mode = !!(sw & M_SWTEXT);
 	bool mixed = !!(sw & M_SWMIXED);
 	bool hires = !!(sw & M_SWHIRES);
 	bool page2 = SWW_GETSTATE(sw, SW80STORE) ? 0 : SWW_GETSTATE(sw, SWPAGE2);
+	// the lores renderer doesn't look at 80STORE
+	bool tpage2 = (!text_mode && !hires) ? !!(sw & M_SWPAGE2) : page2;
+	uint8_t tbase = tpage2 ? 0x08 : 0x04;
+	uint8_t hbase = page2 ? 0x40 : 0x20;
+	uint64_t tl[192 / 64] = {}, hl[192 / 64] = {};
+
+	for (int i = 0; i < 0x60 - 0x04; i++) {
+		if (!(changed[i / 32] & (1u << (i % 32))))
+			continue;
+		int page = 0x04 + i;
+		if (page >= tbase && page < tbase + 0x04) {
+			// a page holds 2 groups of 3 interleaved rows
+			int o = page - tbase;
+			for (int g = o * 2; g < o * 2 + 2; g++)
+				for (int row = g; row < 24; row += 8)
+					tl[row >> 3] |= 0xffull << ((row * 8) & 63);
+		} else if (page >= hbase && page < hbase + 0x20) {
+			// a page holds 6 lines, 8 apart, for the same line & 7
+			int o = page - hbase;
+			for (int g = (o * 2) & 7; g < ((o * 2) & 7) + 2; g++)
+				for (int line = g * 8 + (o >> 2); line < 192; line += 64)
+					hl[line >> 6] |= 1ull << (line & 63);
+		}
+	}
+	// mixed mode splits the screen at line 160, bit 32 of the last word
+	const uint64_t bottom = ~0ull << (MII_VIDEO_MIXED_LINE & 63);
+	for (int i = 0; i < 192 / 64; i++) {
+		uint64_t l = 0;
+		if (text_mode || !hires)
+			l = tl[i];
+		else if (mixed)
+			l = (tl[i] & (i == 2 ? bottom : 0)) |
+					(hl[i] & (i == 2 ? ~bottom : ~0ull));
+		else
+			l = hl[i];
+		lines[i] |= l;
+	}
+}
+#endif
+
+/*
+ * The switches for each range of lines of a frame, from the mode log of the
+ * last complete frame, or sampled now.
+ */
+typedef struct mii_video_split_t {
+	int					count;
+	struct {
+		uint8_t				line;	// first line of the range
+		uint32_t			sw;
+	}					seg[MII_VIDEO_MODE_LOG + 1];
+} mii_video_split_t;
+
+static void
+_mii_video_get_split(
+		mii_t *mii,
+		mii_video_split_t *split)
+{
+	split->count = 1;
+	split->seg[0].line = 0;
+	split->seg[0].sw = mii->sw_state;
+#if MII_VIDEO_MODE_LOG
+	mii_video_t *video = &mii->video;
+	mii_video_mode_log_t log;
+	uint32_t seq;
+	do {	// the CPU core might start reusing it while we copy
+		seq = __atomic_load_n(&video->mode_log_seq, __ATOMIC_ACQUIRE);
+		log = video->mode_log[(seq & 1) ^ 1];
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	} while (seq != __atomic_load_n(&video->mode_log_seq, __ATOMIC_RELAXED));
+	// too many changes, draw it all in the current mode
+	if (log.count > MII_VIDEO_MODE_LOG || !log.line_cycles)
+		return;
+	// keep the switches the log doesn't look at
+	uint32_t keep = mii->sw_state & ~MII_VIDEO_SW_MASK;
+	split->seg[0].sw = keep | log.sw;
+	for (int i = 0; i < log.count; i++) {
+		uint32_t line = log.e[i].cycle / log.line_cycles;
+		uint32_t sw = keep | log.e[i].sw;
+		if (line >= 192)
+			break;
+		if (sw == split->seg[split->count - 1].sw)
+			continue;
+		if (line == split->seg[split->count - 1].line)
+			split->seg[split->count - 1].sw = sw;
+		else {
+			split->seg[split->count].line = line;
+			split->seg[split->count].sw = sw;
+			split->count++;
+		}
+	}
+#endif
+}
+
+// Set lines 'from' to 'to' (excluded) in 'mask', clear the others
+static void
+_mii_video_line_mask(
+		int from,
+		int to,
+		uint64_t *mask)
+{
+	for (int i = 0; i < 192 / 64; i++) {
+		int lo = from - i * 64, hi = to - i * 64;
+		lo = lo < 0 ? 0 : lo > 64 ? 64 : lo;
+		hi = hi < 0 ? 0 : hi > 64 ? 64 : hi;
+		mask[i] = (hi == 64 ? ~0ull : (1ull << hi) - 1) &
+					~(lo == 64 ? ~0ull : (1ull << lo) - 1);
+	}
+}
+
+/*
+ * Everything the pixels depend on, apart from VRAM. A buffer drawn with
+ * another key is redrawn in full.
+ */
+static uint32_t
+_mii_video_mode_key(
+		mii_video_t *video,
+		uint32_t sw)
+{
+	uint32_t key = sw & MII_VIDEO_SW_MASK;
+	key |= (video->an3_mode << 24) | (video->monochrome << 26) |
+				(video->rom_bank << 27);
+	// flashing characters change with the phase
+	bool text = (sw & M_SWTEXT) || ((sw & M_SWHIRES) && (sw & M_SWMIXED));
+	if (text && !(sw & M_SWALTCHARSET))
+		key |= (video->frame_count & MII_VIDEO_FLASH_FRAME_MASK) << 24;
+	return key;
+}
+
+// Slot of a frame buffer in the dirty tracking, new buffers need a full draw
+static int
+_mii_video_fb_slot(
+		mii_video_t *video,
+		uint8_t *fb)
+{
+	for (int i = 0; i < 2; i++)
+		if (video->fb[i] == fb)
+			return i;
+	int i = video->fb[0] != NULL;
+	video->fb[i] = fb;
+	video->fb_mode[i] = ~0;
+	return i;
+}
+
+/*
+ * Collect the lines changed since the last render into both buffers, and
+ * return the ones buffer 'b' needs in 'dirty'. Returns true when it has to
+ * be redrawn in full.
+ */
+static bool
+_mii_video_dirty_lines(
+		mii_t *mii,
+		const mii_video_split_t *split,
+		int b,
+		uint64_t *dirty)
+{
+	mii_video_t *video = &mii->video;
+#if MII_VIDEO_DIRTY_LINES && MII_65C02_WRITE_GEN
+	uint32_t changed[3], aux[3];
+	uint64_t lines[192 / 64] = {};
+
+	mii_bank_changed(&mii->bank[MII_BANK_MAIN], 0x0400, 0x5fff,
+			video->gen[0], changed);
+	mii_bank_changed(&mii->bank[MII_VIDEO_BANK], 0x0400, 0x5fff,
+			video->gen[1], aux);
+	for (int i = 0; i < 3; i++)
+		changed[i] |= aux[i];
+	for (int s = 0; s < split->count; s++) {
+		uint64_t l[192 / 64] = {}, mask[192 / 64];
+		_mii_video_pages_to_lines(split->seg[s].sw, changed, l);
+		_mii_video_line_mask(split->seg[s].line,
+				s + 1 < split->count ? split->seg[s + 1].line : 192, mask);
+		for (int i = 0; i < 192 / 64; i++)
+			lines[i] |= l[i] & mask[i];
+	}
+	for (int i = 0; i < 192 / 64; i++) {
+		video->fb_dirty[0][i] |= lines[i];
+		video->fb_dirty[1][i] |= lines[i];
+	}
+#endif
+	if (video->frame_dirty != video->refresh_seen) {
+		video->refresh_seen = video->frame_dirty;
+		video->fb_mode[0] = video->fb_mode[1] = ~0;
+	}
+	// a split frame is keyed on all its ranges
+	uint32_t mode = _mii_video_mode_key(video, split->seg[0].sw);
+	for (int s = 1; s < split->count; s++)
+		mode = (mode * 31) ^ _mii_video_mode_key(video, split->seg[s].sw) ^
+					split->seg[s].line;
+	bool full = !MII_VIDEO_DIRTY_LINES || !MII_65C02_WRITE_GEN ||
+					mode != video->fb_mode[b];
+	video->fb_mode[b] = mode;
+	for (int i = 0; i < 192 / 64; i++) {
+		dirty[i] = full ? ~0ull : video->fb_dirty[b][i];
+		video->fb_dirty[b][i] = 0;
+	}
+	return full;
+}
+
+/*
+ * Render the lines set in 'dirty' in the mode of 'sw'. With a 'fb_width' of
+ * 0 each line is drawn over the first row of 'hdmi_buffer'.
+ */
+static void
+_mii_video_render_lines(
+		mii_t *mii,
+		uint8_t *hdmi_buffer,
+		int fb_width,
+		uint32_t sw,
+		const uint64_t *dirty)
+{
+	bool text_mode = !!(sw & M_SWTEXT);
+	bool mixed = !!(sw & M_SWMIXED);
+	bool hires = !!(sw & M_SWHIRES);
 	bool col80 = !!(sw & M_SW80COL);
 	bool dhires = !!(sw & M_SWDHIRES);
-	uint8_t an3_mode = video->an3_mode;
-	
+	uint8_t an3_mode = mii->video.an3_mode;
+
 	if (text_mode) {
 		// Pure text mode
-		mii_video_render_text40_rp2350(mii, hdmi_buffer, 320);
+		mii_video_render_text_rp2350(mii, hdmi_buffer, fb_width, sw, dirty);
 	} else if (hires) {
+		uint64_t gfx[192 / 64] = { dirty[0], dirty[1], dirty[2] };
+		uint64_t txt[192 / 64] = {};
+		if (mixed) {
+			// Mixed mode: the bottom 4 text lines (lines 160-191)
+			const uint64_t bottom = ~0ull << (MII_VIDEO_MIXED_LINE & 63);
+			txt[2] = gfx[2] & bottom;
+			gfx[2] &= ~bottom;
+		}
 		// Hi-res graphics mode
 		// DHGR requires: HIRES=1, TEXT=0, DHIRES=1, and either 80COL=1 or an3_mode indicates DHGR
 		// an3_mode: 0=40col text/lores, 1=DHGR color, 2=DHGR mono, 3=80col text
 		bool is_dhgr = dhires && (col80 || (an3_mode >= 1 && an3_mode <= 2));
 		if (is_dhgr) {
-			mii_video_render_dhires_rp2350(mii, hdmi_buffer, 320);
+			mii_video_render_dhires_rp2350(mii, hdmi_buffer, fb_width, sw, gfx);
 		} else {
-			mii_video_render_hires_rp2350(mii, hdmi_buffer, 320);
-		}
-		if (mixed) {
-			// Mixed mode: render bottom 4 text lines (lines 160-191)
-			// This overlays text on top of the HGR screen
-			mii_video_render_text40_mixed_rp2350(mii, hdmi_buffer, 320);
+			mii_video_render_hires_rp2350(mii, hdmi_buffer, fb_width, sw, gfx);
 		}
+		if (mixed)
+			mii_video_render_text_rp2350(mii, hdmi_buffer, fb_width, sw, txt);
 	} else {
 		// Lo-res graphics mode
-		mii_video_render_lores_rp2350(mii, hdmi_buffer, 320);
+		mii_video_render_lores_rp2350(mii, hdmi_buffer, fb_width, sw, dirty);
+	}
+}
+
+// Scale Apple II video to HDMI framebuffer, only redrawing the changed lines
+void
+mii_video_scale_to_hdmi(
+		mii_video_t *video,
+		uint8_t *hdmi_buffer)
+{
+	// Get parent mii structure
+	mii_t *mii = (mii_t *)((char*)video - offsetof(mii_t, video));
+	
+	// The CPU keeps running on the other core, work from the mode log
+	mii_video_split_t split;
+	_mii_video_get_split(mii, &split);
+	uint32_t sw = split.seg[split.count - 1].sw;	// mode at the bottom
+	// lores covers the whole buffer, unless the frame is split
+	bool lores = split.count == 1 && !(sw & M_SWTEXT) && !(sw & M_SWHIRES);
+
+	uint64_t dirty[192 / 64];
+	int b = _mii_video_fb_slot(video, hdmi_buffer);
+	bool full = _mii_video_dirty_lines(mii, &split, b, dirty);
+
+	// the other modes leave borders
+	if (full && !lores) {
+		// Top border: rows 0-23
+		memset(hdmi_buffer, 0, 320 * 24);
+		// Bottom border: rows 216-239
+		memset(hdmi_buffer + 320 * 216, 0, 320 * 24);
+	}
+	// Erase the floppy indicator this buffer was last drawn with
+	if (video->fb_indicator[b] && !full) {
+		if (lores)	// lores blocks 44-47 cover it
+			dirty[176 >> 6] |= 0xffffull << (176 & 63);
+		else
+			for (int y = 0; y < 10; y++)
+				memset(hdmi_buffer + (222 + y) * 320 + 300, 0, 10);
+	}
+	
+	if (split.count == 1)
+		_mii_video_render_lines(mii, hdmi_buffer, 320, sw, dirty);
+	else for (int s = 0; s < split.count; s++) {
+		uint64_t lines[192 / 64];
+		uint32_t ssw = split.seg[s].sw;
+		_mii_video_line_mask(split.seg[s].line,
+				s + 1 < split.count ? split.seg[s + 1].line : 192, lines);
+		for (int i = 0; i < 192 / 64; i++)
+			lines[i] &= dirty[i];
+		if ((ssw & M_SWTEXT) || (ssw & M_SWHIRES)) {
+			_mii_video_render_lines(mii, hdmi_buffer, 320, ssw, lines);
+			continue;
+		}
+		// lores blocks at the scale of the other modes, as for scanlines
+		for (int l = 0; l < 192; l++) {
+			if (!((lines[l >> 6] >> (l & 63)) & 1))
+				continue;
+			uint64_t one[192 / 64] = {};
+			one[l >> 6] = 1ull << (l & 63);
+			_mii_video_render_lines(mii, hdmi_buffer + (24 + l) * 320, 0,
+					ssw, one);
+		}
 	}
 	
 	// Draw floppy activity indicator in bottom border
 	int motor_state = mii_disk2_get_motor_state();
-	if (motor_state > 0) {
-		mii_video_draw_floppy_indicator(hdmi_buffer, motor_state, mii->video.frame_count);
+	video->fb_indicator[b] = motor_state > 0 &&
+			mii_video_draw_floppy_indicator(hdmi_buffer, motor_state,
+					mii->video.frame_count);
+	video->renders++;
+}
+
+// Mode of the frame being raced, taken on line 0
+static mii_video_split_t _mii_video_scan_split;
+
+/*
+ * Draw one line of the screen, for racing the beam: the same renderers, on a
+ * single line with a row stride of 0. A split frame is drawn with lores at
+ * the scale of the other modes.
+ */
+void
+mii_video_scanline(
+		mii_video_t *video,
+		int y,
+		uint8_t *line)
+{
+	mii_t *mii = (mii_t *)((char*)video - offsetof(mii_t, video));
+	mii_video_split_t *split = &_mii_video_scan_split;
+
+	if (y == 0)
+		_mii_video_get_split(mii, split);
+	uint32_t sw = split->seg[0].sw;
+	bool lores = !(sw & M_SWTEXT) && !(sw & M_SWHIRES);
+	int l = y - 24;		// Apple II line
+
+	if (split->count == 1 && lores)
+		l = (y / 5) * 4;	// 8x5 blocks, over the borders too
+	else if (l < 0 || l >= 192)
+		memset(line, 0, 320);
+	if (l >= 0 && l < 192) {
+		for (int s = 1; s < split->count && split->seg[s].line <= l; s++)
+			sw = split->seg[s].sw;
+		uint64_t dirty[192 / 64] = {};
+		dirty[l >> 6] = 1ull << (l & 63);
+		_mii_video_render_lines(mii, line, 0, sw, dirty);
 	}
+	mii_video_draw_floppy_row(line, y, mii_disk2_get_motor_state(),
+			video->frame_count);
 }
 
 #endif // MII_RP2350
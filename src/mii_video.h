@@ -19,6 +19,53 @@
  */
 #define MII_VIDEO_DEBUG_HEAPMAP	0
 
+/*
+ * RP2350: only redraw the lines whose VRAM pages were written since that
+ * HDMI buffer was last drawn, using the page write generations. Mode, page
+ * and flash phase changes still redraw the whole buffer.
+ */
+#ifndef MII_VIDEO_DIRTY_LINES
+#define MII_VIDEO_DIRTY_LINES	1
+#endif
+
+/*
+ * RP2350: decode HGR lines from tables of the 7 pixels of a byte in each
+ * context, stored a word at a time, instead of pixel by pixel.
+ */
+#ifndef MII_VIDEO_HGR_LUT
+#define MII_VIDEO_HGR_LUT		1
+#endif
+
+/*
+ * RP2350: draw text from a copy of the character ROM bank in SRAM, and
+ * tables of the pixels of each glyph line, stored a word at a time.
+ */
+#ifndef MII_VIDEO_GLYPH_CACHE
+#define MII_VIDEO_GLYPH_CACHE	1
+#endif
+
+/*
+ * RP2350: video switch changes logged per frame, stamped with the cycle, so
+ * the renderer draws each range of lines in the mode it was displayed in.
+ * A frame with more changes is drawn in one mode. 0 disables the log.
+ */
+#ifndef MII_VIDEO_MODE_LOG
+#define MII_VIDEO_MODE_LOG		16
+#endif
+
+/*
+ * RP2350: race the beam. Core 1 draws each screen line straight from VRAM
+ * into a ring of this many lines, kept ahead of the HDMI scan-out, and a
+ * single frame buffer is kept for the UI and as a fallback. 0 disables it
+ * and keeps the two frame buffers, it needs at least 2.
+ */
+#ifndef MII_VIDEO_SCANLINE
+#define MII_VIDEO_SCANLINE		0
+#endif
+#if MII_VIDEO_SCANLINE == 1
+#error MII_VIDEO_SCANLINE needs at least 2 lines
+#endif
+
 // TODO move VRAM stuff to somewhere else
 #define MII_VIDEO_WIDTH		(280 * 2)
 #define MII_VIDEO_HEIGHT	(192 * 2)
@@ -59,6 +106,20 @@ typedef union mii_video_clut_t {
 	mii_color_t 		colors[(2*16) + 16 + 10 /*+ 8*/ + 2 + 2];
 } mii_video_clut_t;
 
+#if MII_RP2350 && MII_VIDEO_MODE_LOG
+// The video switch changes of one frame
+typedef struct mii_video_mode_log_t {
+	uint64_t			start;		// cycle of the first visible line
+	uint32_t			line_cycles;
+	uint32_t			sw;			// switches at the first line
+	uint8_t				count;		// > MII_VIDEO_MODE_LOG when overflowed
+	struct {
+		uint32_t			cycle;	// since 'start'
+		uint32_t			sw;
+	}					e[MII_VIDEO_MODE_LOG];
+} mii_video_mode_log_t;
+#endif
+
 typedef struct mii_video_t {
 	void *				state;		// protothread state in mii_video.c
 	mii_rom_t *			rom;		// video ROM
@@ -77,7 +138,7 @@ typedef struct mii_video_t {
 	mii_video_clut_t	clut_low; 	// low luminance version
 	// function pointer to the line drawing function
 	mii_video_cb_t		line_cb;
-	uint8_t 			frame_dirty;
+	uint8_t 			frame_dirty;	// RP2350: bumped for a full redraw
 	// increments when pixels have changed for this frame
 	uint32_t 			frame_seed;
 	/*
@@ -90,7 +151,34 @@ typedef struct mii_video_t {
 	uint8_t 			video_hmap[192]
 			__attribute__((aligned(32))) ; // line dirty heat map
 #endif
-#if !MII_RP2350
+#if MII_RP2350
+	/*
+	 * Dirty lines of each HDMI buffer, as they are drawn every other frame.
+	 * 'gen' holds the write generations of the main and aux pages $04-$5F
+	 * as of the last render.
+	 */
+	uint8_t *			fb[2];
+	uint32_t			fb_mode[2];		// mode the buffer was drawn in
+	uint64_t			fb_dirty[2][192 / 64];
+	uint8_t				fb_indicator[2]; // floppy indicator is drawn
+	uint8_t				refresh_seen;	// last frame_dirty rendered
+	uint32_t			gen[2][0x60 - 0x04];
+	// glyph cache, the character ROM bank 'glyph_rom' copied out of flash
+	uint8_t				glyph[256][8];
+	const uint8_t *		glyph_rom;
+	uint32_t			lines_drawn;	// stats, reset by the caller
+	uint32_t			renders;
+#if MII_VIDEO_MODE_LOG
+	/*
+	 * Written by the CPU core, it switches logs at each VBL. The renderer
+	 * reads the other one, 'mode_log_seq' tells it which, and if it
+	 * changed under its feet.
+	 */
+	mii_video_mode_log_t	mode_log[2];
+	uint32_t			mode_log_seq;
+	uint32_t			mode_log_sw;	// last logged switches
+#endif
+#else
 	// alignment is required for vector extensions
 	// This buffer is 860KB - way too large for RP2350!
 	uint32_t 			pixels[MII_VIDEO_WIDTH * MII_VIDEO_HEIGHT]
@@ -126,6 +214,10 @@ mii_video_OOB_write_check(
 uint8_t
 mii_video_get_vapor(
 		struct mii_t *mii);
+// Redraw the whole screen on the next render
+void
+mii_video_full_refresh(
+		struct mii_t *mii);
 #if MII_RP2350
 void
 mii_video_render(
@@ -136,6 +228,13 @@ mii_video_scale_to_hdmi(
 		struct mii_video_t *video,
 		uint8_t *hdmi_buffer);
 
+// Draw line 'y' (0-239) of the HDMI screen into 'line', 320 pixels
+void
+mii_video_scanline(
+		struct mii_video_t *video,
+		int y,
+		uint8_t *line);
+
 void
 mii_video_reset_vbl_timer(
 		struct mii_t *mii);
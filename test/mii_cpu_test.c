@@ -0,0 +1,920 @@
+/*
+ * mii_cpu_test.c
+ *
+ * Host side test harness for the 65C02 core, with a flat 64KB memory.
+ *
+ * Runs the SingleStepTests 65C02 JSON vectors (one file per opcode,
+ * https://github.com/SingleStepTests/65x02 'wdc65c02/v1/xx.json'), checking
+ * registers, memory, cycle count and bus traffic; then runs a fixed
+ * throughput benchmark.
+ *
+ * It builds two ways (see Makefile): with the generic callback core, where
+ * every bus access is checked, and with MII_RP2350 where the core uses the
+ * same fast path as on the device (page table, threaded dispatch, caches,
+ * loop skipping...), and only I/O page accesses go through the callback.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <time.h>
+
+#ifndef MII_RP2350
+#define MII_RP2350 0
+#endif
+
+#include "mii_65c02.h"
+#include "mii_bank.h"
+#if MII_RP2350
+#include "mii.h"
+#endif
+
+static uint8_t ram[0x10000];
+
+#if MII_RP2350
+static mii_t g_mii;
+static uint32_t ram_gen[256];
+#define CPU	(&g_mii.cpu)
+
+void
+mii_timer_run(
+		mii_t *mii,
+		uint64_t cycles)
+{
+	mii->timer.last_run += cycles;
+}
+#else
+static mii_cpu_t g_cpu;
+#define CPU	(&g_cpu)
+#endif
+
+/* bus accesses seen by the callback, for the current test */
+#define BUS_LOG_SIZE	64
+static struct {
+	uint16_t	addr;
+	uint8_t		data, w;
+}	bus_log[BUS_LOG_SIZE];
+static int bus_count;
+
+static mii_cpu_state_t
+_test_access(
+		mii_cpu_t *cpu,
+		mii_cpu_state_t s)
+{
+	if (s.w)
+		ram[s.addr] = s.data;
+	else
+		s.data = ram[s.addr];
+	if (bus_count < BUS_LOG_SIZE) {
+		bus_log[bus_count].addr = s.addr;
+		bus_log[bus_count].data = s.data;
+		bus_log[bus_count].w = s.w;
+	}
+	bus_count++;
+	return s;
+}
+
+static void
+_test_poke(
+		uint16_t addr,
+		uint8_t val)
+{
+	ram[addr] = val;
+#if MII_RP2350
+	ram_gen[addr >> 8]++;
+#endif
+}
+
+static void
+_test_init(void)
+{
+	mii_cpu_t *cpu = CPU;
+	memset(cpu, 0, sizeof(*cpu));
+	cpu->access = _test_access;
+	cpu->ram = ram;
+#if MII_RP2350
+	cpu->access_param = &g_mii;
+	g_mii.timer.next_event = UINT64_MAX;
+	g_mii.timer.head = MII_TIMER_NONE;
+	g_mii.bank[MII_BANK_MAIN].mem = ram;
+	g_mii.bank[MII_BANK_MAIN].size = 256;
+	g_mii.bank[MII_BANK_MAIN].gen = ram_gen;
+	for (int i = 0; i < 256; i++) {
+		g_mii.mem[i].read = g_mii.mem[i].write = MII_BANK_MAIN;
+		g_mii.mem_read[i] = g_mii.mem_write[i] = ram + (i << 8);
+		g_mii.mem_write_gen[i] = &ram_gen[i];
+	}
+	// the I/O page takes the slow path, as set by mii_page_table_build()
+	g_mii.mem_read[0xc0] = g_mii.mem_write[0xc0] = NULL;
+#else
+	cpu->access_param = NULL;
+#endif
+}
+
+/*
+ * Minimal JSON parser, enough for the test vectors; strings are
+ * terminated in place in the file buffer.
+ */
+enum {
+	JSON_NUM = 0,
+	JSON_STR,
+	JSON_ARRAY,
+	JSON_OBJECT,
+	JSON_OTHER,		// true, false, null
+};
+
+typedef struct json_t {
+	uint8_t			type;
+	const char *	key;
+	const char *	str;
+	long			num;
+	struct json_t *	child;
+	struct json_t *	next;
+} json_t;
+
+static char *
+_json_skip(
+		char *p)
+{
+	while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')
+		p++;
+	return p;
+}
+
+static char *
+_json_string(
+		char *p,
+		const char **out)
+{
+	// p is past the opening quote
+	*out = p;
+	while (*p && *p != '"') {
+		if (*p == '\\' && p[1])
+			p++;
+		p++;
+	}
+	if (*p)
+		*p++ = 0;
+	return p;
+}
+
+static void
+json_free(
+		json_t *j)
+{
+	while (j) {
+		json_t *next = j->next;
+		json_free(j->child);
+		free(j);
+		j = next;
+	}
+}
+
+static json_t *
+json_parse(
+		char **pp)
+{
+	char *p = _json_skip(*pp);
+	json_t *j = calloc(1, sizeof(*j));
+
+	if (*p == '{' || *p == '[') {
+		const char end = *p == '{' ? '}' : ']';
+		json_t **last = &j->child;
+		j->type = *p == '{' ? JSON_OBJECT : JSON_ARRAY;
+		p = _json_skip(p + 1);
+		while (*p && *p != end) {
+			const char *key = NULL;
+			if (j->type == JSON_OBJECT) {
+				if (*p != '"')
+					goto error;
+				p = _json_skip(_json_string(p + 1, &key));
+				if (*p != ':')
+					goto error;
+				p++;
+			}
+			json_t *c = json_parse(&p);
+			if (!c)
+				goto error;
+			c->key = key;
+			*last = c;
+			last = &c->next;
+			p = _json_skip(p);
+			if (*p == ',')
+				p = _json_skip(p + 1);
+		}
+		if (*p != end)
+			goto error;
+		p++;
+	} else if (*p == '"') {
+		j->type = JSON_STR;
+		p = _json_string(p + 1, &j->str);
+	} else if (*p == '-' || (*p >= '0' && *p <= '9')) {
+		j->type = JSON_NUM;
+		j->num = strtol(p, &p, 10);
+		while (*p == '.' || *p == 'e' || *p == 'E' || *p == '+' ||
+				*p == '-' || (*p >= '0' && *p <= '9'))
+			p++;
+	} else if (*p >= 'a' && *p <= 'z') {
+		j->type = JSON_OTHER;
+		while (*p >= 'a' && *p <= 'z')
+			p++;
+	} else
+		goto error;
+	*pp = p;
+	return j;
+error:
+	*pp = p;
+	json_free(j);
+	return NULL;
+}
+
+static json_t *
+json_get(
+		const json_t *j,
+		const char *key)
+{
+	for (json_t *c = j ? j->child : NULL; c; c = c->next)
+		if (c->key && !strcmp(c->key, key))
+			return c;
+	return NULL;
+}
+
+static long
+json_num(
+		const json_t *j,
+		const char *key)
+{
+	const json_t *c = json_get(j, key);
+	return c && c->type == JSON_NUM ? c->num : -1;
+}
+
+/* [addr, value(, "read"/"write")] */
+static long
+json_idx(
+		const json_t *j,
+		int idx)
+{
+	const json_t *c = j ? j->child : NULL;
+	while (c && idx--)
+		c = c->next;
+	return c && c->type == JSON_NUM ? c->num : -1;
+}
+
+#if !MII_RP2350
+static const char *
+json_idx_str(
+		const json_t *j,
+		int idx)
+{
+	const json_t *c = j ? j->child : NULL;
+	while (c && idx--)
+		c = c->next;
+	return c && c->type == JSON_STR ? c->str : "";
+}
+#endif
+
+static struct {
+	int		verbose;
+	int		strict;		// bus traffic has to match cycle by cycle
+} opt;
+
+enum {
+	FAIL_REG = 0,
+	FAIL_MEM,
+	FAIL_CYCLES,
+	FAIL_BUS,
+	FAIL_COUNT,
+};
+static const char * const fail_name[FAIL_COUNT] = {
+	"registers", "memory", "cycles", "bus",
+};
+
+typedef struct test_stats_t {
+	uint32_t	run, pass;
+	uint32_t	fail[FAIL_COUNT];
+} test_stats_t;
+
+#if !MII_RP2350
+/*
+ * Check the bus accesses the core made against the expected cycles. The
+ * core doesn't do all the 'dummy' accesses the real chip does, so by
+ * default they only need to appear in order; with -s they have to match
+ * one for one.
+ */
+static int
+_test_bus(
+		const json_t *cycles)
+{
+	if (bus_count > BUS_LOG_SIZE)
+		return 0;
+	const json_t *c = cycles ? cycles->child : NULL;
+	for (int i = 0; i < bus_count; i++) {
+		for (; c; c = c->next) {
+			int w = json_idx_str(c, 2)[0] == 'w';
+			if (json_idx(c, 0) == bus_log[i].addr &&
+					json_idx(c, 1) == bus_log[i].data && w == bus_log[i].w)
+				break;
+			if (opt.strict)
+				return 0;
+		}
+		if (!c)
+			return 0;
+		c = c->next;
+	}
+	return !opt.strict || !c;
+}
+#endif
+
+static int
+_test_one(
+		const json_t *t,
+		test_stats_t *st)
+{
+	mii_cpu_t *cpu = CPU;
+	const json_t *init = json_get(t, "initial");
+	const json_t *final = json_get(t, "final");
+	const json_t *cycles = json_get(t, "cycles");
+	const char *name = json_get(t, "name") ? json_get(t, "name")->str : "?";
+	int fail[FAIL_COUNT] = {};
+
+	if (!init || !final)
+		return -1;
+	for (json_t *r = json_get(init, "ram") ? json_get(init, "ram")->child :
+				NULL; r; r = r->next)
+		_test_poke(json_idx(r, 0), json_idx(r, 1));
+	cpu->PC = json_num(init, "pc");
+	cpu->S = json_num(init, "s");
+	cpu->A = json_num(init, "a");
+	cpu->X = json_num(init, "x");
+	cpu->Y = json_num(init, "y");
+	cpu->P.P = json_num(init, "p");
+	cpu->IRQ = 0;
+	cpu->ir_log = 0;
+	cpu->cycle = 0;
+	cpu->instruction_run = 0;	// just the one
+	bus_count = 0;
+
+	mii_cpu_state_t s = { .raw = 0 };
+	s = mii_cpu_run(cpu, s, UINT64_MAX);
+
+	if (cpu->PC != json_num(final, "pc") || cpu->S != json_num(final, "s") ||
+			cpu->A != json_num(final, "a") || cpu->X != json_num(final, "x") ||
+			cpu->Y != json_num(final, "y") || cpu->P.P != json_num(final, "p"))
+		fail[FAIL_REG] = 1;
+	for (json_t *r = json_get(final, "ram") ? json_get(final, "ram")->child :
+				NULL; r; r = r->next)
+		if (ram[(uint16_t)json_idx(r, 0)] != json_idx(r, 1))
+			fail[FAIL_MEM] = 1;
+	int count = 0;
+	for (json_t *c = cycles ? cycles->child : NULL; c; c = c->next)
+		count++;
+	// the opcode fetch cycle was accounted for before cpu->cycle restarted
+	if (1 + cpu->cycle != count)
+		fail[FAIL_CYCLES] = 1;
+#if !MII_RP2350
+	if (!_test_bus(cycles))
+		fail[FAIL_BUS] = 1;
+#endif
+	int failed = 0;
+	for (int i = 0; i < FAIL_COUNT; i++) {
+		st->fail[i] += fail[i];
+		failed |= fail[i];
+	}
+	st->run++;
+	if (!failed) {
+		st->pass++;
+		return 0;
+	}
+	if (opt.verbose) {
+		printf("  FAIL '%s':", name);
+		for (int i = 0; i < FAIL_COUNT; i++)
+			if (fail[i])
+				printf(" %s", fail_name[i]);
+		printf("\n    got PC:%04x S:%02x A:%02x X:%02x Y:%02x P:%02x "
+				"cycles:%d\n", cpu->PC, cpu->S, cpu->A, cpu->X, cpu->Y,
+				cpu->P.P, 1 + cpu->cycle);
+		printf("    exp PC:%04lx S:%02lx A:%02lx X:%02lx Y:%02lx P:%02lx "
+				"cycles:%d\n", json_num(final, "pc"), json_num(final, "s"),
+				json_num(final, "a"), json_num(final, "x"),
+				json_num(final, "y"), json_num(final, "p"), count);
+		opt.verbose--;	// only the first few
+	}
+	return 1;
+}
+
+static int
+_test_file(
+		const char *path,
+		test_stats_t *total)
+{
+	FILE *f = fopen(path, "rb");
+	if (!f) {
+		perror(path);
+		return -1;
+	}
+	fseek(f, 0, SEEK_END);
+	long size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	char *buf = malloc(size + 1);
+	if (fread(buf, 1, size, f) != (size_t)size) {
+		perror(path);
+		fclose(f);
+		free(buf);
+		return -1;
+	}
+	buf[size] = 0;
+	fclose(f);
+
+	test_stats_t st = {};
+	// parse one test at a time, the files are big
+	char *p = _json_skip(buf);
+	if (*p == '[')
+		p = _json_skip(p + 1);
+	while (*p && *p != ']') {
+		json_t *t = json_parse(&p);
+		if (!t) {
+			fprintf(stderr, "%s: parse error at offset %ld\n",
+					path, (long)(p - buf));
+			break;
+		}
+		_test_one(t, &st);
+		json_free(t);
+		p = _json_skip(p);
+		if (*p == ',')
+			p = _json_skip(p + 1);
+	}
+	free(buf);
+	printf("%s: %u/%u passed", path, st.pass, st.run);
+	for (int i = 0; i < FAIL_COUNT; i++)
+		if (st.fail[i])
+			printf(", %u %s", st.fail[i], fail_name[i]);
+	printf("\n");
+	total->run += st.run;
+	total->pass += st.pass;
+	for (int i = 0; i < FAIL_COUNT; i++)
+		total->fail[i] += st.fail[i];
+	return 0;
+}
+
+static int
+_cmp_name(
+		const void *a,
+		const void *b)
+{
+	return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+/* all the .json files of a directory, in order */
+static void
+_test_dir(
+		const char *path,
+		test_stats_t *total)
+{
+	DIR *d = opendir(path);
+	if (!d) {
+		_test_file(path, total);
+		return;
+	}
+	char **names = NULL;
+	int count = 0;
+	struct dirent *e;
+	while ((e = readdir(d)) != NULL) {
+		size_t l = strlen(e->d_name);
+		if (l < 5 || strcmp(e->d_name + l - 5, ".json"))
+			continue;
+		names = realloc(names, (count + 1) * sizeof(*names));
+		names[count] = malloc(strlen(path) + l + 2);
+		sprintf(names[count], "%s/%s", path, e->d_name);
+		count++;
+	}
+	closedir(d);
+	qsort(names, count, sizeof(*names), _cmp_name);
+	for (int i = 0; i < count; i++) {
+		_test_file(names[i], total);
+		free(names[i]);
+	}
+	free(names);
+}
+
+/*
+ * Throughput benchmark; a loop with a mix of addressing modes, a
+ * subroutine call and stack traffic, run in one frame's worth of cycles
+ * per mii_cpu_run() call, like mii_run_cycles() does.
+ */
+static const uint8_t bench_code[] = {
+	0xa2, 0x00,				// 0800 LDX #$00
+	0xbd, 0x00, 0x10,		// 0802 LDA $1000,X
+	0x18,					// 0805 CLC
+	0x69, 0x03,				// 0806 ADC #$03
+	0x9d, 0x00, 0x11,		// 0808 STA $1100,X
+	0x51, 0xf0,				// 080B EOR ($F0),Y
+	0x91, 0xf0,				// 080D STA ($F0),Y
+	0xc8,					// 080F INY
+	0x20, 0x19, 0x08,		// 0810 JSR $0819
+	0xe8,					// 0813 INX
+	0xd0, 0xec,				// 0814 BNE $0802
+	0x4c, 0x00, 0x08,		// 0816 JMP $0800
+	0x48,					// 0819 PHA
+	0x8a,					// 081A TXA
+	0x2a,					// 081B ROL
+	0x68,					// 081C PLA
+	0x60,					// 081D RTS
+};
+/*
+ * Store bound loop, a screen clear like fill; compare MII_65C02_WRITE_GEN
+ * on and off to see what the page generation counters cost.
+ */
+static const uint8_t bench_store_code[] = {
+	0xa2, 0x00,				// 0800 LDX #$00
+	0x9d, 0x00, 0x20,		// 0802 STA $2000,X
+	0x9d, 0x00, 0x21,		// 0805 STA $2100,X
+	0x9d, 0x00, 0x22,		// 0808 STA $2200,X
+	0x9d, 0x00, 0x23,		// 080B STA $2300,X
+	0x95, 0x80,				// 080E STA $80,X
+	0xe8,					// 0810 INX
+	0xd0, 0xef,				// 0811 BNE $0802
+	0x1a,					// 0813 INC A
+	0x4c, 0x00, 0x08,		// 0814 JMP $0800
+};
+#define BENCH_FRAME	17030	// cycles per NTSC frame
+
+/*
+ * 'watch' is a page to take off the fast path, like a watchpoint does
+ * (see mii_debug_bp_set()), 0 for none.
+ */
+static void
+_bench(
+		const char *name,
+		const uint8_t *code,
+		unsigned size,
+		uint64_t cycles,
+		uint8_t watch)
+{
+	mii_cpu_t *cpu = CPU;
+
+	_test_init();
+	memset(ram, 0, sizeof(ram));
+	for (unsigned i = 0; i < size; i++)
+		_test_poke(0x0800 + i, code[i]);
+	_test_poke(0xf0, 0x00);
+	_test_poke(0xf1, 0x12);
+	_test_poke(0xfffc, 0x00);
+	_test_poke(0xfffd, 0x08);
+#if MII_RP2350
+	if (watch)
+		g_mii.mem_read[watch] = g_mii.mem_write[watch] = NULL;
+#else
+	if (watch)
+		return;
+#endif
+
+	mii_cpu_state_t s = { .reset = 1 };
+	uint64_t instructions = 0;
+	struct timespec t0, t1;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	while (cpu->total_cycle < cycles) {
+		cpu->instruction_run = UINT32_MAX;
+		s = mii_cpu_run(cpu, s, cpu->total_cycle + BENCH_FRAME);
+		instructions += (uint64_t)UINT32_MAX - cpu->instruction_run + 1;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	double ns = (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+	char what[32];
+	snprintf(what, sizeof(what), watch ? "%s, $%02x00 watched" : "%s",
+			name, watch);
+	printf("bench %s: %llu cycles, %llu instructions in %.3fs: "
+			"%.2f emulated MHz, %.2f ns per instruction\n", what,
+			(unsigned long long)cpu->total_cycle,
+			(unsigned long long)instructions, ns / 1e9,
+			cpu->total_cycle * 1e3 / ns, ns / instructions);
+}
+
+#if MII_RP2350 && MII_65C02_ROM_HOOKS
+/*
+ * ROM hooks; the Monitor routines they replace are run through the core,
+ * then again with the hooks on, and have to end up the same. The ROM
+ * bytes come from mii_rom_hook.c, which checks them before installing.
+ */
+static mii_cpu_decoded_t hook_decoded[MII_ROM_DECODED_SIZE];
+
+static const struct {
+	uint16_t		addr;
+	uint8_t			code[24];
+} hook_rom[] = {
+	{ 0xfca8, { 0x38, 0x48, 0xe9, 0x01, 0xd0, 0xfc, 0x68, 0xe9, 0x01,
+				0xd0, 0xf6, 0x60 } },									// WAIT
+	{ 0xfbc1, { 0x48, 0x4a, 0x29, 0x03, 0x09, 0x04, 0x85, 0x29, 0x68,
+				0x29, 0x18, 0x90, 0x02, 0x69, 0x7f, 0x85, 0x28, 0x0a,
+				0x0a, 0x05, 0x28, 0x85, 0x28, 0x60 } },					// BASCALC
+};
+
+/* LDA #a / JSR addr / trap, returns the CPU state at the trap */
+static mii_cpu_t
+_test_hook_run(
+		uint16_t addr,
+		uint8_t a,
+		bool hooks)
+{
+	mii_cpu_t *cpu = CPU;
+	const uint8_t code[] = { 0xa9, a, 0x20, addr & 0xff, addr >> 8,
+						MII_TRAP >> 8, MII_TRAP & 0xff };
+
+	_test_init();
+	cpu->trap = MII_TRAP;
+	for (int i = MII_ROM_DECODED_BASE >> 8; i <= 0xff; i++)
+		g_mii.mem[i].read = MII_BANK_ROM;
+	memset(ram, 0, 0x200);
+	for (unsigned i = 0; i < sizeof(code); i++)
+		_test_poke(0x0800 + i, code[i]);
+	mii_rom_hook_enable(&g_mii, hooks);
+	mii_cpu_state_t s = { .reset = 1 };
+	do {
+		cpu->instruction_run = UINT32_MAX;
+		s = mii_cpu_run(cpu, s, UINT64_MAX);
+	} while (!s.trap);
+	return *cpu;
+}
+
+static int
+_test_rom_hooks(void)
+{
+	int fail = 0, run = 0;
+
+	memset(ram, 0, sizeof(ram));
+	for (unsigned i = 0; i < sizeof(hook_rom) / sizeof(hook_rom[0]); i++)
+		for (unsigned b = 0; b < sizeof(hook_rom[i].code); b++)
+			ram[hook_rom[i].addr + b] = hook_rom[i].code[b];
+	ram[0xfffc] = 0x00;
+	ram[0xfffd] = 0x08;
+	mii_cpu_decode(ram + MII_ROM_DECODED_BASE, MII_ROM_DECODED_SIZE,
+			hook_decoded);
+	g_mii.rom_decoded = hook_decoded;
+	g_mii.rom_hook.count = 0;
+	mii_rom_hook_install(&g_mii);
+
+	for (int h = 0; h < g_mii.rom_hook.count; h++) {
+		mii_rom_hook_t *hook = &g_mii.rom_hook.hook[h];
+		for (int a = 0; a < 256; a++) {
+			mii_cpu_t rom = _test_hook_run(hook->addr, a, false);
+			uint8_t rom_mem[0x200];
+			memcpy(rom_mem, ram, sizeof(rom_mem));
+			uint32_t calls = hook->calls;
+			mii_cpu_t hle = _test_hook_run(hook->addr, a, true);
+			uint8_t rp = 0, hp = 0;
+			MII_GET_P(&rom, rp);
+			MII_GET_P(&hle, hp);
+			run++;
+			if (hook->calls == calls || rom.A != hle.A || rom.X != hle.X ||
+					rom.Y != hle.Y || rom.S != hle.S || rp != hp ||
+					rom.PC != hle.PC || rom.total_cycle != hle.total_cycle ||
+					memcmp(rom_mem, ram, sizeof(rom_mem))) {
+				if (fail++ < opt.verbose)
+					printf("hook %s A=%02x: A %02x/%02x P %02x/%02x "
+							"cycles %llu/%llu%s\n", hook->name, a,
+							rom.A, hle.A, rp, hp,
+							(unsigned long long)rom.total_cycle,
+							(unsigned long long)hle.total_cycle,
+							hook->calls == calls ? " (not called)" : "");
+			}
+		}
+	}
+	mii_rom_hook_enable(&g_mii, false);
+	g_mii.rom_decoded = NULL;
+	printf("rom hooks: %d/%d passed\n", run - fail, run);
+	return fail;
+}
+#endif
+
+/*
+ * Decimal mode ADC and SBC, checked for every A, operand and carry against
+ * the nibble arithmetic the core used before MII_65C02_BCD_TABLES (this
+ * is a copy of it). The SingleStepTests vectors only cover a few thousand
+ * random decimal cases.
+ */
+typedef struct bcd_ref_t {
+	uint8_t		a, c, z, n, v;
+} bcd_ref_t;
+
+static bcd_ref_t
+_bcd_ref(
+		uint8_t a,
+		uint8_t operand,
+		uint8_t c,
+		bool sbc)
+{
+	bcd_ref_t r = {};
+	uint8_t D = sbc ? 0x99 - operand : operand;
+	uint8_t lo = (a & 0x0f) + (D & 0x0f) + c;
+	if (lo > 9) lo += 6;
+	uint8_t hi = (a >> 4) + (D >> 4) + (lo > 0x0f);
+	r.v = !!((!((a ^ D) & 0x80) && ((a ^ (hi << 4))) & 0x80));
+	if (hi > 9) hi += 6;
+	r.c = hi > 15;
+	r.a = (hi << 4) | (lo & 0x0f);
+	r.n = !!(r.a & 0x80);
+	// SBC takes Z from the binary sum
+	r.z = sbc ? ((uint8_t)(a + D + c)) == 0 : r.a == 0;
+	return r;
+}
+
+static int
+_test_bcd(void)
+{
+	mii_cpu_t *cpu = CPU;
+	int fail = 0, run = 0;
+
+	_test_init();
+	for (int op = 0; op < 2; op++) {
+		bool sbc = op == 1;
+		_test_poke(0x0800, sbc ? 0xe9 : 0x69);	// ADC/SBC #imm
+		for (int d = 0; d < 256; d++) {
+			_test_poke(0x0801, d);
+			for (int i = 0; i < 512; i++) {
+				uint8_t a = i >> 1, c = i & 1, p = 0x08 | c;	// D, C
+				cpu->PC = 0x0800;
+				cpu->A = a;
+				MII_SET_P(cpu, p);
+				cpu->cycle = 0;
+				cpu->instruction_run = 0;
+				mii_cpu_state_t s = { .raw = 0 };
+				mii_cpu_run(cpu, s, UINT64_MAX);
+				bcd_ref_t r = _bcd_ref(a, d, c, sbc);
+				run++;
+				// 2 cycles, as in binary mode
+				if (cpu->A != r.a || cpu->P.C != r.c || cpu->P.Z != r.z ||
+						cpu->P.N != r.n || cpu->P.V != r.v ||
+						1 + cpu->cycle != 2) {
+					if (fail++ < opt.verbose)
+						printf("%s %02x %02x C:%d: A %02x/%02x "
+								"CZNV %d%d%d%d/%d%d%d%d\n",
+								sbc ? "SBC" : "ADC", a, d, c, cpu->A, r.a,
+								cpu->P.C, cpu->P.Z, cpu->P.N, cpu->P.V,
+								r.c, r.z, r.n, r.v);
+				}
+			}
+		}
+	}
+	printf("decimal ADC/SBC: %d/%d passed\n", run - fail, run);
+	return fail;
+}
+
+/*
+ * cpu->irq_pending is an IRQ line that doesn't need a bus access to be
+ * seen: taken at the next instruction boundary when I is clear.
+ */
+static int
+_test_irq(void)
+{
+	mii_cpu_t *cpu = CPU;
+	const uint8_t code[] = { 0x58, 0xea, 0xea };	// CLI, NOP, NOP
+	int fail = 0;
+
+	_test_init();
+	for (unsigned i = 0; i < sizeof(code); i++)
+		_test_poke(0x0800 + i, code[i]);
+	_test_poke(0x0900, 0xea);
+	_test_poke(0xfffe, 0x00);
+	_test_poke(0xffff, 0x09);
+	cpu->PC = 0x0800;
+	cpu->S = 0xff;
+	MII_SET_P(cpu, 0x04);	// I
+	cpu->irq_pending = 1 << 3;
+	mii_cpu_state_t s = { .raw = 0 };
+	cpu->instruction_run = 0;
+	s = mii_cpu_run(cpu, s, UINT64_MAX);	// CLI, masked until then
+	fail += cpu->PC != 0x0801;
+	cpu->instruction_run = 0;
+	s = mii_cpu_run(cpu, s, UINT64_MAX);	// vector, then the handler's NOP
+	fail += cpu->PC != 0x0901 || cpu->S != 0xfc || !cpu->P.I;
+	fail += ram[0x1ff] != 0x08 || ram[0x1fe] != 0x01;
+	// stamped during this run, before the handler's NOP
+	fail += cpu->irq_vector_cycle > cpu->total_cycle ||
+				cpu->total_cycle - cpu->irq_vector_cycle > 12;
+	// a run that ends on the vector stops before the handler's first one
+	cpu->PC = 0x0801;
+	cpu->S = 0xff;
+	MII_SET_P(cpu, 0);
+	cpu->instruction_run = 0;
+	s = mii_cpu_run(cpu, s, cpu->total_cycle + cpu->cycle + 1);
+	fail += cpu->PC != 0x0900 || !cpu->P.I;
+	cpu->irq_pending = 0;
+	printf("irq: %s\n", fail ? "FAILED" : "passed");
+	return fail;
+}
+
+/*
+ * mii_bank_write()/mii_bank_read() copy whole pages, except the ones with
+ * an access callback, that has to see every byte.
+ */
+static int bank_cb_calls;
+
+static bool
+_test_bank_cb(
+		struct mii_bank_t *bank,
+		void *param,
+		uint16_t addr,
+		uint8_t *byte,
+		bool write)
+{
+	if (!bank)		// disposing
+		return false;
+	bank_cb_calls++;
+	if ((addr & 0xff) != 0x10)
+		return false;
+	if (!write)		// $xx10 is a register, not memory
+		*byte = 0xee;
+	return true;
+}
+
+static int
+_test_bank_range(void)
+{
+	static uint8_t mem[0x400];
+	static uint32_t gen[4];
+	uint8_t src[0x300], dst[0x300];
+	mii_bank_t bank = {
+		.base = 0x2000, .size = 4, .no_alloc = 1, .mem = mem, .gen = gen,
+	};
+	int fail = 0;
+
+	for (int i = 0; i < (int)sizeof(src); i++)
+		src[i] = i * 7 + 1;
+	mii_bank_install_access_cb(&bank, _test_bank_cb, NULL, 0x21, 0);
+	mii_bank_write(&bank, 0x2080, src, sizeof(src));
+	for (int i = 0; i < (int)sizeof(src); i++)
+		fail += mem[0x80 + i] != (0x80 + i == 0x110 ? 0 : src[i]);
+	fail += bank_cb_calls != 256;
+	fail += gen[0] != 1 || gen[1] != 1 || gen[2] != 1 || gen[3] != 1;
+
+	bank_cb_calls = 0;
+	mii_bank_read(&bank, 0x2080, dst, sizeof(dst));
+	for (int i = 0; i < (int)sizeof(dst); i++)
+		fail += dst[i] != (0x80 + i == 0x110 ? 0xee : src[i]);
+	fail += bank_cb_calls != 256;
+	mii_bank_dispose(&bank);
+	printf("bank range: %s\n", fail ? "FAILED" : "passed");
+	return fail;
+}
+
+int
+main(
+		int argc,
+		const char *argv[])
+{
+	uint64_t bench_cycles = 200000000;
+	test_stats_t total = {};
+	int files = 0;
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-v"))
+			opt.verbose = 10;
+		else if (!strcmp(argv[i], "-s"))
+			opt.strict = 1;
+		else if (!strcmp(argv[i], "-b") && i + 1 < argc)
+			bench_cycles = strtoull(argv[++i], NULL, 0);
+		else if (argv[i][0] == '-') {
+			fprintf(stderr, "%s: [-v] [-s] [-b <cycles>] "
+					"[<dir>|<file.json>...]\n"
+					"  -v  show the first failures\n"
+					"  -s  bus traffic has to match cycle by cycle\n"
+					"  -b  cycles to run for the benchmark, 0 = none\n",
+					argv[0]);
+			exit(1);
+		} else {
+			_test_init();
+			_test_dir(argv[i], &total);
+			files++;
+		}
+	}
+	printf("core: %s%s%s\n", MII_RP2350 ? "rp2350 fast path, " : "callback, ",
+			MII_65C02_THREADED ? "threaded" : "switch",
+			MII_RP2350 && !MII_65C02_WRITE_GEN ? ", no write generations" : "");
+	if (files) {
+		printf("total: %u/%u passed", total.pass, total.run);
+		for (int i = 0; i < FAIL_COUNT; i++)
+			if (total.fail[i])
+				printf(", %u %s", total.fail[i], fail_name[i]);
+		printf("\n");
+	}
+#if MII_RP2350 && MII_65C02_ROM_HOOKS
+	int fail = _test_rom_hooks();
+#else
+	int fail = 0;
+#endif
+	fail += _test_bcd();
+	fail += _test_irq();
+	fail += _test_bank_range();
+	if (bench_cycles) {
+		_bench("mix", bench_code, sizeof(bench_code), bench_cycles, 0);
+		_bench("store", bench_store_code, sizeof(bench_store_code),
+				bench_cycles, 0);
+		// a watched page the code doesn't use, then one it stores to
+		_bench("mix", bench_code, sizeof(bench_code), bench_cycles, 0x95);
+		_bench("mix", bench_code, sizeof(bench_code), bench_cycles, 0x11);
+	}
+	return total.pass != total.run || fail;
+}
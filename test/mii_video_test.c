@@ -0,0 +1,428 @@
+/*
+ * mii_video_test.c
+ *
+ * Host side test of the RP2350 HGR and text renderers. The table driven
+ * line decoders have to give the same pixels as the pixel by pixel ones, on
+ * their own and through mii_video_scale_to_hdmi(); then both are timed over
+ * full frames. Lines raced with mii_video_scanline() have to match the
+ * frame buffer too, and so do the frames only redrawn where VRAM changed.
+ *
+ * mii_video.c is included rather than linked, for its static functions.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <time.h>
+
+#include "mii_video.c"
+
+static mii_t g_mii;
+static uint8_t main_ram[0x10000], aux_ram[0x10000], sw_ram[0x100];
+static uint32_t main_gen[0x100], aux_gen[0x100];
+static uint8_t fb[320 * 240] __attribute__((aligned(4)));
+static uint8_t ref[320 * 240];
+static uint8_t char_rom[8 * 1024];
+static mii_rom_t video_rom = {
+	.name = "test_video", .rom = char_rom, .len = sizeof(char_rom),
+};
+
+/* what mii_video.c needs from the rest of the emulator */
+int
+mii_disk2_get_motor_state(void)
+{
+	return 0;
+}
+
+mii_rom_t *
+mii_rom_get(
+		const char *name)
+{
+	return NULL;
+}
+
+uint8_t
+mii_timer_register(
+		mii_t *mii,
+		mii_timer_p cb,
+		void *param,
+		int64_t when,
+		const char *name)
+{
+	return 0;
+}
+
+int64_t
+mii_timer_get(
+		mii_t *mii,
+		uint8_t timer_id)
+{
+	return 0;
+}
+
+int
+mii_timer_set(
+		mii_t *mii,
+		uint8_t timer_id,
+		int64_t when)
+{
+	return 0;
+}
+
+static void
+_test_init(void)
+{
+	g_mii.bank[MII_BANK_MAIN].mem = main_ram;
+	g_mii.bank[MII_BANK_MAIN].size = 256;
+	g_mii.bank[MII_BANK_MAIN].gen = main_gen;
+	g_mii.bank[MII_VIDEO_BANK].mem = aux_ram;
+	g_mii.bank[MII_VIDEO_BANK].size = 256;
+	g_mii.bank[MII_VIDEO_BANK].gen = aux_gen;
+	g_mii.bank[MII_BANK_SW].mem = sw_ram;
+	g_mii.bank[MII_BANK_SW].base = 0xc000;
+	g_mii.bank[MII_BANK_SW].size = 1;
+	mii_video_init(&g_mii);
+	// the tables are only built when the renderer uses them
+	_mii_hgr_lut_init();
+	_mii_text_lut_init();
+	for (unsigned i = 0; i < sizeof(char_rom); i++)
+		char_rom[i] = rand();
+	g_mii.video.rom = &video_rom;
+}
+
+static void
+_fill(
+		uint8_t *p,
+		int len,
+		int pattern)
+{
+	static const uint8_t fixed[] = { 0x00, 0x7f, 0xff, 0x55, 0xaa, 0xd5 };
+	for (int i = 0; i < len; i++) {
+		if (pattern < (int)sizeof(fixed))
+			p[i] = fixed[pattern] ^ ((i & 1) && pattern >= 3 ? 0x7f : 0);
+		else
+			p[i] = rand();
+	}
+}
+
+static double
+_now_us(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1e6 + t.tv_nsec / 1e3;
+}
+
+/* the table decoder against the pixel by pixel one, on single lines */
+static int
+_test_hgr_lines(void)
+{
+	uint8_t src[40], a[280], b[280] __attribute__((aligned(4)));
+	int fail = 0, run = 0;
+
+	for (int n = 0; n < 200000; n++) {
+		_fill(src, sizeof(src), n);
+		for (int mono = 0; mono < 2; mono++, run++) {
+			_mii_hgr_line_pixels(src, a, mono);
+			_mii_hgr_line_lut(src, b, mono);
+			fail += memcmp(a, b, sizeof(a)) != 0;
+		}
+	}
+	printf("hgr lines: %d/%d identical\n", run - fail, run);
+	return fail != 0;
+}
+
+/* full frames through the renderer, against the pixel by pixel decoder */
+static int
+_test_hgr_frames(void)
+{
+	int fail = 0, run = 0;
+
+	for (int n = 0; n < 64; n++) {
+		bool page2 = n & 1;
+		bool mono = n & 2;
+		_fill(main_ram + 0x2000, 0x4000, n / 4);
+		g_mii.sw_state = M_SWHIRES | (page2 ? M_SWPAGE2 : 0);
+		g_mii.video.monochrome = mono;
+		mii_video_full_refresh(&g_mii);
+		memset(fb, 0x5a, sizeof(fb));
+		mii_video_scale_to_hdmi(&g_mii.video, fb);
+
+		memset(ref, 0, sizeof(ref));
+		for (int line = 0; line < 192; line++)
+			_mii_hgr_line_pixels(main_ram + _mii_line_to_video_addr(
+						page2 ? 0x4000 : 0x2000, line),
+					ref + (24 + line) * 320 + 20, mono);
+		fail += memcmp(fb, ref, sizeof(fb)) != 0;
+		run++;
+	}
+	printf("hgr frames: %d/%d identical\n", run - fail, run);
+	return fail != 0;
+}
+
+/* glyph cache against the ROM decoded bit by bit, 40 and 80 columns */
+static int
+_test_text_lines(void)
+{
+	uint8_t m[40], x[40], a[320], b[320] __attribute__((aligned(4)));
+	const uint8_t (*glyph)[8] = _mii_video_glyphs(&g_mii.video, char_rom);
+	int fail = 0, run = 0;
+
+	for (int n = 0; n < 20000; n++) {
+		_fill(m, sizeof(m), n);
+		_fill(x, sizeof(x), n + 1);
+		for (int mode = 0; mode < 6; mode++, run++) {
+			const uint8_t *aux = mode & 1 ? x : NULL;
+			int flash = (mode >> 1) == 0 ? 0 : (mode >> 1) == 1 ? 0x40 : -0x40;
+			_mii_text_line_pixels(m, aux, char_rom, n & 7, flash, a);
+			_mii_text_line_glyphs(m, aux, glyph, n & 7, flash, b);
+			fail += memcmp(a, b, sizeof(a)) != 0;
+		}
+	}
+	printf("text lines: %d/%d identical\n", run - fail, run);
+	return fail != 0;
+}
+
+/* text frames through the renderer, ROM banks, charsets and flash phases */
+static int
+_test_text_frames(void)
+{
+	int fail = 0, run = 0;
+
+	for (int n = 0; n < 64; n++) {
+		bool col80 = n & 1, altset = n & 2, page2 = n & 4;
+		g_mii.video.rom_bank = (n >> 3) & 1;
+		g_mii.video.frame_count = (n & 16) ? 0x10 : 0;
+		_fill(main_ram + 0x400, 0x800, n / 4);
+		_fill(aux_ram + 0x400, 0x800, n / 4 + 1);
+		g_mii.sw_state = M_SWTEXT | (col80 ? M_SW80COL : 0) |
+				(altset ? M_SWALTCHARSET : 0) | (page2 ? M_SWPAGE2 : 0);
+		mii_video_full_refresh(&g_mii);
+		memset(fb, 0x5a, sizeof(fb));
+		mii_video_scale_to_hdmi(&g_mii.video, fb);
+
+		const uint8_t *rom = char_rom + (g_mii.video.rom_bank ? 4096 : 0);
+		int flash = altset ? 0 : (n & 16) ? -0x40 : 0x40;
+		uint16_t base = page2 ? 0x800 : 0x400;
+		memset(ref, 0, sizeof(ref));
+		for (int line = 0; line < 192; line++) {
+			int row = line >> 3;
+			uint16_t addr = base + (row & 7) * 0x80 + (row / 8) * 0x28;
+			_mii_text_line_pixels(main_ram + addr,
+					col80 ? aux_ram + addr : NULL, rom, line & 7, flash,
+					ref + (24 + line) * 320);
+		}
+		fail += memcmp(fb, ref, sizeof(fb)) != 0;
+		run++;
+	}
+	g_mii.video.rom_bank = 0;
+	printf("text frames: %d/%d identical\n", run - fail, run);
+	return fail != 0;
+}
+
+/* each mode a line at a time, against the whole frame */
+static int
+_test_scanline(void)
+{
+	static const uint32_t modes[] = {
+		M_SWTEXT, M_SWTEXT | M_SW80COL, M_SWHIRES, M_SWHIRES | M_SWMIXED,
+		M_SWHIRES | M_SWPAGE2, M_SWHIRES | M_SWDHIRES | M_SW80COL, 0,
+		M_SWPAGE2, M_SWMIXED,
+	};
+	uint8_t line[320] __attribute__((aligned(4)));
+	int fail = 0, run = 0;
+
+	for (int n = 0; n < 4 * (int)(sizeof(modes) / sizeof(modes[0])); n++) {
+		_fill(main_ram + 0x400, 0x5c00, n % 4 + 3);
+		_fill(aux_ram + 0x400, 0x5c00, n % 4 + 4);
+		g_mii.sw_state = modes[n / 4];
+		g_mii.video.monochrome = n & 1;
+		mii_video_full_refresh(&g_mii);
+		memset(fb, 0x5a, sizeof(fb));
+		mii_video_scale_to_hdmi(&g_mii.video, fb);
+		for (int y = 0; y < 240; y++, run++) {
+			memset(line, 0x5a, sizeof(line));
+			mii_video_scanline(&g_mii.video, y, line);
+			fail += memcmp(line, fb + y * 320, sizeof(line)) != 0;
+		}
+	}
+	g_mii.video.monochrome = 0;
+	printf("scanlines: %d/%d identical\n", run - fail, run);
+	return fail != 0;
+}
+
+/*
+ * Frames drawn into two buffers in turn, as for HDMI, with a few bytes
+ * written to the text and HGR pages of both banks in between; only the
+ * changed lines are redrawn, and each frame has to match a full redraw.
+ * The last modes change half way down, from the mode log.
+ */
+static int
+_test_dirty(void)
+{
+	static const struct { uint32_t sw; int line; uint32_t split; } modes[] = {
+		{ M_SWTEXT }, { M_SWTEXT | M_SW80COL }, { 0 }, { M_SWPAGE2 },
+		{ M_SWMIXED }, { M_SWHIRES }, { M_SWHIRES | M_SWMIXED },
+		{ M_SWHIRES | M_SWPAGE2 }, { M_SWHIRES | M_SWDHIRES | M_SW80COL },
+		{ M_SWTEXT, 96, M_SWHIRES },
+		{ M_SWHIRES | M_SWDHIRES | M_SW80COL, 40, M_SWTEXT | M_SW80COL },
+		{ 0, 130, M_SWHIRES | M_SWMIXED },
+	};
+	static const uint16_t pages[] = { 0x400, 0x800, 0x2000, 0x4000 };
+	static uint8_t buf[2][320 * 240] __attribute__((aligned(4)));
+	static mii_video_t saved;
+	mii_video_t *video = &g_mii.video;
+	mii_video_mode_log_t *log = &video->mode_log[(video->mode_log_seq & 1) ^ 1];
+	int fail = 0, run = 0;
+	uint32_t drawn = 0;
+
+	_fill(main_ram + 0x400, 0x5c00, 100);
+	_fill(aux_ram + 0x400, 0x5c00, 101);
+	memset(buf, 0x5a, sizeof(buf));
+	video->fb[0] = video->fb[1] = NULL;
+	for (int m = 0; m < (int)(sizeof(modes) / sizeof(modes[0])); m++) {
+		g_mii.sw_state = modes[m].line ? modes[m].split : modes[m].sw;
+		memset(log, 0, sizeof(*log));
+		if (modes[m].line) {
+			log->line_cycles = 65;
+			log->sw = modes[m].sw;
+			log->count = 1;
+			log->e[0].cycle = modes[m].line * 65 + 30;
+			log->e[0].sw = modes[m].split;
+		}
+		for (int f = 0; f < 300; f++, run++) {
+			for (int w = rand() % 4; w > 0; w--) {
+				uint16_t base = pages[rand() % 4];
+				uint16_t addr = base + rand() % (base < 0x2000 ? 0x400 : 0x2000);
+				uint8_t v = rand();
+				mii_bank_write(&g_mii.bank[rand() & 1 ?
+						MII_BANK_MAIN : MII_VIDEO_BANK], addr, &v, 1);
+			}
+			video->frame_count = f;		// flash phases
+			uint32_t lines = video->lines_drawn;
+			mii_video_scale_to_hdmi(video, buf[f & 1]);
+			drawn += video->lines_drawn - lines;
+
+			saved = *video;
+			mii_video_full_refresh(&g_mii);
+			mii_video_scale_to_hdmi(video, ref);
+			*video = saved;
+			fail += memcmp(buf[f & 1], ref, sizeof(ref)) != 0;
+		}
+	}
+	memset(log, 0, sizeof(*log));
+	video->fb[0] = video->fb[1] = NULL;
+	video->frame_count = 0;
+	printf("dirty frames: %d/%d identical, %u lines redrawn\n",
+			run - fail, run, drawn);
+	return fail != 0;
+}
+
+static void
+_bench_text(
+		int frames)
+{
+	const uint8_t (*glyph)[8] = _mii_video_glyphs(&g_mii.video, char_rom);
+
+	_fill(main_ram + 0x400, 0x400, 100);
+	_fill(aux_ram + 0x400, 0x400, 101);
+	for (int col80 = 0; col80 < 2; col80++) {
+		const uint8_t *aux = col80 ? aux_ram : NULL;
+		double t0 = _now_us();
+		for (int f = 0; f < frames; f++)
+			for (int line = 0; line < 192; line++)
+				_mii_text_line_pixels(main_ram + 0x400 + (line >> 3) * 40,
+						aux ? aux + 0x400 + (line >> 3) * 40 : NULL,
+						char_rom, line & 7, 0x40, fb + (24 + line) * 320);
+		double t1 = _now_us();
+		for (int f = 0; f < frames; f++)
+			for (int line = 0; line < 192; line++)
+				_mii_text_line_glyphs(main_ram + 0x400 + (line >> 3) * 40,
+						aux ? aux + 0x400 + (line >> 3) * 40 : NULL,
+						glyph, line & 7, 0x40, fb + (24 + line) * 320);
+		double t2 = _now_us();
+		printf("bench text %d columns: %.1f us per frame bit by bit, "
+				"%.1f us from the glyph cache\n", col80 ? 80 : 40,
+				(t1 - t0) / frames, (t2 - t1) / frames);
+	}
+}
+
+/* time a line of each mode takes, against the 63us it is on screen */
+static void
+_bench_scanline(
+		int frames)
+{
+	static const struct { uint32_t sw; const char *name; } modes[] = {
+		{ M_SWTEXT, "text 40" }, { M_SWTEXT | M_SW80COL, "text 80" },
+		{ M_SWHIRES, "hgr" }, { M_SWHIRES | M_SWDHIRES | M_SW80COL, "dhgr" },
+		{ 0, "lores" },
+	};
+	uint8_t line[320] __attribute__((aligned(4)));
+
+	_fill(main_ram + 0x400, 0x5c00, 100);
+	_fill(aux_ram + 0x400, 0x5c00, 101);
+	for (int m = 0; m < (int)(sizeof(modes) / sizeof(modes[0])); m++) {
+		g_mii.sw_state = modes[m].sw;
+		double t0 = _now_us();
+		for (int f = 0; f < frames; f++)
+			for (int y = 0; y < 240; y++)
+				mii_video_scanline(&g_mii.video, y, line);
+		printf("bench scanline %s: %.2f us per line\n", modes[m].name,
+				(_now_us() - t0) / frames / 240);
+	}
+}
+
+static void
+_bench_hgr(
+		int frames)
+{
+	_fill(main_ram + 0x2000, 0x2000, 100);
+	for (int mono = 0; mono < 2; mono++) {
+		double t0 = _now_us();
+		for (int f = 0; f < frames; f++)
+			for (int line = 0; line < 192; line++)
+				_mii_hgr_line_pixels(main_ram + _mii_line_to_video_addr(
+							0x2000, line), fb + (24 + line) * 320 + 20, mono);
+		double t1 = _now_us();
+		for (int f = 0; f < frames; f++)
+			for (int line = 0; line < 192; line++)
+				_mii_hgr_line_lut(main_ram + _mii_line_to_video_addr(
+							0x2000, line), fb + (24 + line) * 320 + 20, mono);
+		double t2 = _now_us();
+		g_mii.sw_state = M_SWHIRES;
+		g_mii.video.monochrome = mono;
+		for (int f = 0; f < frames; f++) {
+			mii_video_full_refresh(&g_mii);
+			mii_video_scale_to_hdmi(&g_mii.video, fb);
+		}
+		double t3 = _now_us();
+		printf("bench hgr %s: %.1f us per frame pixel by pixel, "
+				"%.1f us from tables, %.1f us full redraw (%s)\n",
+				mono ? "mono" : "color", (t1 - t0) / frames,
+				(t2 - t1) / frames, (t3 - t2) / frames,
+				MII_VIDEO_HGR_LUT ? "tables" : "pixel by pixel");
+	}
+}
+
+int
+main(
+		int argc,
+		const char *argv[])
+{
+	int frames = 2000;
+
+	if (argc > 2 && !strcmp(argv[1], "-b"))
+		frames = atoi(argv[2]);
+	_test_init();
+	int fail = _test_hgr_lines();
+	fail += _test_hgr_frames();
+	fail += _test_text_lines();
+	fail += _test_text_frames();
+	fail += _test_scanline();
+	fail += _test_dirty();
+	if (frames) {
+		_bench_hgr(frames);
+		_bench_text(frames);
+		_bench_scanline(frames);
+	}
+	return fail;
+}